@@ -2,39 +2,155 @@
 
 #pragma once
 #include <cstdlib>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <type_traits>
 #include <algorithm>
+#include <tuple>
+#include <limits>
+#include <utility>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <cstdio>
+#include "bagel_jobs.h"
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define BAGEL_MMAP 1
+#endif
+// With BAGEL_THREAD_WORLDS every thread hosts its own World: the ECS state
+// is thread_local and Jobs runs tasks on the calling thread.
+#ifdef BAGEL_THREAD_WORLDS
+#define BAGEL_PER_WORLD thread_local
+#else
+#define BAGEL_PER_WORLD
+#endif
 
 namespace bagel
 {
+	// Memory behind DynamicBag (see MallocAlloc, HugePageAlloc, VirtualAlloc).
+	enum class BagAllocator { Malloc, HugePages, Virtual };
+
 	struct Bagel
 	{
 		bool	DynamicResize = false;
+		BagAllocator	Allocator = BagAllocator::Malloc;
+		std::size_t		VirtualReserve = std::size_t{256} << 20;	// per bag
 		int		IdBagSize = 5;
 		int		InitialEntities = 30;
 		int		InitialPackedSize = 5;
 		int		MaxComponents = 50;
+		int		ChunkSize = 16*1024;
+		int		PageBytes = 4*1024;	// PagedBag
+		int		IndexBits = 24;
 	};
 
+	template <class...> struct TypeList {};
+	template <auto...> struct FieldList {};
+
+	template <class T> struct Fields;
+	template <class T> struct Indexes { using type = FieldList<>; };
+	template <class T> struct Tracked : std::false_type {};
+	// Fields SoAStorage keeps in side tables, away from its columns.
+	template <class T> struct Cold { using type = FieldList<>; };
+	// Fields written by World::snapshot for types not trivially copyable.
+	template <class T> struct Serialized { using type = void; };
+
+	// Lifecycle hooks declared with BAGEL_ON_ADD/REMOVE/DESTROY, called as
+	// hook(ent_type, component): OnAdd once the component is in place,
+	// OnRemove before delComponent drops it, OnDestroy (OnRemove unless
+	// declared) for each component of an entity being destroyed. Hooks must
+	// not add or remove components or entities.
+	template <class T> struct OnAdd : std::false_type {};
+	template <class T> struct OnRemove : std::false_type {};
+	template <class T> struct OnDestroy : OnRemove<T> {};
+
+	// World singletons declared with BAGEL_RESOURCES (see World::resource).
+	template <class = void> struct Resources { using type = TypeList<>; };
+
+	// Owning groups declared with BAGEL_GROUP; groupOf finds T's group.
+	template <class ...Ts> class Group;
+	template <class T, class ...Ts>
+	constexpr inline bool contains_v = (std::is_same_v<T,Ts> || ...);
+	void groupOf(...);
+
 	template <class T> struct Storage;
 	template <class T> class PackedStorage;
 	template <class T> class SparseStorage;
 	template <class T> class TaggedStorage;
+	template <class T> class TagSetStorage;
+	template <class T> class SharedStorage;
+	template <class T> class SharedSetStorage;
+	template <class T> class ChunkedStorage;
+	template <class T, class = typename Fields<T>::type> class SoAStorage;
+
+	// Components declared with BAGEL_STORAGE, numbered in declaration order.
+	template <int> struct Registered;
+	enum : int { RegistryBase = __COUNTER__ };
 
 #if __has_include("bagel_cfg.h")
-	#define BAGEL_STORAGE(C,T) template <> struct Storage<C> { using type = T<C>; };
+	#define BAGEL_STORAGE(C,T) template <> struct Storage<C> { using type = T<C>; }; \
+		template <> struct Registered<__COUNTER__-RegistryBase-1> { using type = C; };
+	#define BAGEL_FIELDS(C,...) template <> struct Fields<C> { using type = FieldList<__VA_ARGS__>; };
+	#define BAGEL_INDEX(C,...) template <> struct Indexes<C> { using type = FieldList<__VA_ARGS__>; };
+	#define BAGEL_COLD(C,...) template <> struct Cold<C> { using type = FieldList<__VA_ARGS__>; };
+	#define BAGEL_GROUP(...) template <class T, std::enable_if_t<contains_v<T,__VA_ARGS__>,int> = 0> \
+		Group<__VA_ARGS__> groupOf(TypeList<T>);
+	#define BAGEL_TRACK(C) template <> struct Tracked<C> : std::true_type {};
+	#define BAGEL_SERIALIZE(C,...) template <> struct Serialized<C> { using type = FieldList<__VA_ARGS__>; };
+	#define BAGEL_HOOK(H,C,F) template <> struct H<C> : std::true_type { \
+		template <class ...As> static void call(As&&... as) { F(std::forward<As>(as)...); } };
+	#define BAGEL_ON_ADD(C,F) BAGEL_HOOK(OnAdd,C,F)
+	#define BAGEL_ON_REMOVE(C,F) BAGEL_HOOK(OnRemove,C,F)
+	#define BAGEL_ON_DESTROY(C,F) BAGEL_HOOK(OnDestroy,C,F)
+	#define BAGEL_RESOURCES(...) template <> struct Resources<> { using type = TypeList<__VA_ARGS__>; };
 	#include "bagel_cfg.h"
+	#undef BAGEL_RESOURCES
+	#undef BAGEL_ON_DESTROY
+	#undef BAGEL_ON_REMOVE
+	#undef BAGEL_ON_ADD
+	#undef BAGEL_HOOK
+	#undef BAGEL_SERIALIZE
+	#undef BAGEL_TRACK
+	#undef BAGEL_GROUP
+	#undef BAGEL_COLD
+	#undef BAGEL_INDEX
+	#undef BAGEL_FIELDS
 	#undef BAGEL_STORAGE
 #else
 	constexpr Bagel Params{};
 #endif
+	constexpr inline int RegisteredCount = __COUNTER__-RegistryBase-1;
 
 	using id_type = int;
-	struct ent_type { id_type id; };
+	constexpr inline id_type IndexMask = (1<<Params.IndexBits)-1;
+
+	/**
+	 * Entity handle: the low IndexBits of id select the slot, the remaining
+	 * bits (sign bit excluded) count how many times the slot was recycled.
+	 * A handle is alive while its generation matches the slot's. The
+	 * generation wraps after 2^(31-IndexBits) reuses of a slot (128 by
+	 * default), so a handle kept that long may pass World::alive again.
+	 */
+	struct ent_type
+	{
+		id_type id;
+
+		constexpr id_type index() const { return id & IndexMask; }
+		constexpr id_type generation() const { return id >> Params.IndexBits; }
+	};
 	using size_type = int;
 	using index_type = int;
+	using tick_type = std::uint32_t;
 	using mask_type =
 		std::conditional_t<Params.MaxComponents<=8, std::uint_fast8_t,
 		std::conditional_t<Params.MaxComponents<=16, std::uint_fast16_t,
@@ -49,172 +165,2049 @@ namespace bagel
 		void operator=(const NoCopy&) = delete;
 	};
 
-	template <class T, int N>
+	/**
+	 * DynamicBag allocation policies. Each provides:
+	 *  allocate/release(p, bytes, align)
+	 *  extend(p, bytes, newBytes): grows a block in place, or returns false;
+	 *  reallocate(p, bytes, newBytes, align): grows a block that may move,
+	 *    only used for trivially copyable elements.
+	 */
+	struct MallocAlloc final : NoInstance
+	{
+		static void* allocate(std::size_t bytes, std::size_t align) {
+			if (align > alignof(std::max_align_t))
+				return operator new(bytes, std::align_val_t{align});
+			return malloc(bytes);
+		}
+		static void release(void* p, std::size_t, std::size_t align) {
+			if (align > alignof(std::max_align_t)) operator delete(p, std::align_val_t{align});
+			else free(p);
+		}
+		static bool extend(void*, std::size_t, std::size_t) { return false; }
+		static void* reallocate(void* p, std::size_t bytes, std::size_t newBytes, std::size_t align) {
+			if (align <= alignof(std::max_align_t))
+				return realloc(p, newBytes);
+			void* q = allocate(newBytes, align);
+			memcpy(q, p, bytes);
+			release(p, bytes, align);
+			return q;
+		}
+	};
+
+	/**
+	 * Blocks from huge-page mappings. Blocks of at least HugePage bytes get
+	 * their own mapping, grown with mremap (the kernel moves page tables, not
+	 * data). Smaller ones are cut from shared HugePage regions in power-of-2
+	 * size classes and recycled through per-class free lists.
+	 */
+	struct HugePageAlloc final : NoInstance
+	{
+		static constexpr std::size_t HugePage = std::size_t{2} << 20;
+
+		static void* allocate(std::size_t bytes, std::size_t align) {
+#ifdef BAGEL_MMAP
+			if (bytes >= HugePage)
+				return map(round(bytes));
+			const index_type c = sizeClass(std::max(bytes, align));
+			std::lock_guard<std::mutex> l(arena().lock);
+			Arena& a = arena();
+			if (void* p = a.free[c]) {
+				a.free[c] = *static_cast<void**>(p);
+				return p;
+			}
+			const std::size_t size = MinClass << c;
+			a.used = (a.used + size-1) & ~(size-1);
+			if (a.used + size > HugePage) {
+				a.region = static_cast<std::byte*>(map(HugePage));
+				a.used = 0;
+			}
+			void* p = a.region + a.used;
+			a.used += size;
+			return p;
+#else
+			return MallocAlloc::allocate(bytes, align);
+#endif
+		}
+		static void release(void* p, std::size_t bytes, std::size_t align) {
+#ifdef BAGEL_MMAP
+			if (bytes >= HugePage) {
+				munmap(p, round(bytes));
+				return;
+			}
+			const index_type c = sizeClass(std::max(bytes, align));
+			std::lock_guard<std::mutex> l(arena().lock);
+			*static_cast<void**>(p) = arena().free[c];
+			arena().free[c] = p;
+#else
+			MallocAlloc::release(p, bytes, align);
+#endif
+		}
+		static bool extend([[maybe_unused]] void* p, [[maybe_unused]] std::size_t bytes, [[maybe_unused]] std::size_t newBytes) {
+#ifdef BAGEL_MMAP
+			if (bytes < HugePage)
+				return false;
+#ifdef MREMAP_MAYMOVE
+			return mremap(p, round(bytes), round(newBytes), 0) != MAP_FAILED;
+#else
+			return round(bytes) == round(newBytes);
+#endif
+#else
+			return false;
+#endif
+		}
+		static void* reallocate(void* p, std::size_t bytes, std::size_t newBytes, std::size_t align) {
+#if defined(BAGEL_MMAP) && defined(MREMAP_MAYMOVE)
+			if (bytes >= HugePage) {
+				void* q = mremap(p, round(bytes), round(newBytes), MREMAP_MAYMOVE);
+				if (q != MAP_FAILED)
+					return q;
+			}
+#endif
+			if (extend(p, bytes, newBytes))
+				return p;
+			void* q = allocate(newBytes, align);
+			memcpy(q, p, bytes);
+			release(p, bytes, align);
+			return q;
+		}
+	private:
+		static constexpr std::size_t MinClass = 64;
+
+		struct Arena
+		{
+			std::mutex	lock;
+			std::byte*	region = nullptr;
+			std::size_t	used = HugePage;
+			void*		free[32] = {};
+		};
+		static Arena& arena() {
+			static Arena a;
+			return a;
+		}
+		static index_type sizeClass(std::size_t bytes) {
+			index_type c = 0;
+			while ((MinClass << c) < bytes)
+				++c;
+			return c;
+		}
+		static std::size_t round(std::size_t bytes) { return (bytes + HugePage-1) & ~(HugePage-1); }
+#ifdef BAGEL_MMAP
+		// Throws std::bad_alloc if neither mapping succeeds.
+		static void* map(std::size_t bytes) {
+			void* p;
+#ifdef MAP_HUGETLB
+			p = mmap(nullptr, bytes, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+			if (p != MAP_FAILED)
+				return p;
+#endif
+			p = mmap(nullptr, bytes, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+			if (p == MAP_FAILED)
+				throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+			madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+			return p;
+		}
+#endif
+	};
+
+	/**
+	 * Blocks at the start of a Params.VirtualReserve address range reserved
+	 * up front; growing commits more pages behind the data, so elements never
+	 * move. Blocks outgrowing the reserve move to a range of their own size.
+	 * allocate throws std::bad_alloc if the range cannot be mapped.
+	 */
+	struct VirtualAlloc final : NoInstance
+	{
+		static void* allocate(std::size_t bytes, [[maybe_unused]] std::size_t align) {
+#ifdef BAGEL_MMAP
+			void* p = mmap(nullptr, reserved(bytes), PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+			if (p == MAP_FAILED)
+				throw std::bad_alloc();
+			if (mprotect(p, round(bytes), PROT_READ|PROT_WRITE) != 0) {
+				munmap(p, reserved(bytes));
+				throw std::bad_alloc();
+			}
+			return p;
+#else
+			return MallocAlloc::allocate(bytes, align);
+#endif
+		}
+		static void release(void* p, std::size_t bytes, [[maybe_unused]] std::size_t align) {
+#ifdef BAGEL_MMAP
+			munmap(p, reserved(bytes));
+#else
+			MallocAlloc::release(p, bytes, align);
+#endif
+		}
+		static bool extend([[maybe_unused]] void* p, [[maybe_unused]] std::size_t bytes, [[maybe_unused]] std::size_t newBytes) {
+#ifdef BAGEL_MMAP
+			if (round(newBytes) > reserved(bytes))
+				return false;
+			return mprotect(p, round(newBytes), PROT_READ|PROT_WRITE) == 0;
+#else
+			return false;
+#endif
+		}
+		static void* reallocate(void* p, std::size_t bytes, std::size_t newBytes, std::size_t align) {
+			if (extend(p, bytes, newBytes))
+				return p;
+			void* q = allocate(newBytes, align);
+			memcpy(q, p, bytes);
+			release(p, bytes, align);
+			return q;
+		}
+	private:
+		static std::size_t page() {
+#ifdef BAGEL_MMAP
+			static const std::size_t size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+			return size;
+#else
+			return 4096;
+#endif
+		}
+		static std::size_t round(std::size_t bytes) { return (bytes + page()-1) & ~(page()-1); }
+		// Blocks are at most one reserve apart, so the size tells the range.
+		static std::size_t reserved(std::size_t bytes) { return std::max(round(Params.VirtualReserve), round(bytes)); }
+	};
+
+	using DefaultAlloc =
+		std::conditional_t<Params.Allocator == BagAllocator::HugePages, HugePageAlloc,
+		std::conditional_t<Params.Allocator == BagAllocator::Virtual, VirtualAlloc,
+			MallocAlloc>>;
+
+	/**
+	 * Growable array. Only the first size() slots hold live Ts: push, emplace,
+	 * append and resize construct them, pop, clear and resize destroy them.
+	 * Trivially copyable elements may still be assigned past size() after
+	 * ensure(). Growth extends the block in place when the allocator can (see
+	 * VirtualAlloc), and otherwise move-constructs the elements into a new
+	 * block; trivially copyable elements are handed to the allocator's
+	 * reallocate instead.
+	 */
+	template <class T, int N, size_type A = alignof(T), class Alloc = DefaultAlloc>
 	class DynamicBag : NoCopy
 	{
 	public:
-		void push(const T& t) {
-			if (_size == _capacity) {
-				_capacity *= 2;
-				_arr = static_cast<T*>(
-					realloc(_arr, sizeof(T)*_capacity));
-			}
-			_arr[_size] = t;
+		void push(const T& t) { emplace(t); }
+		void push(T&& t) { emplace(std::move(t)); }
+		template <class ...Args>
+		T& emplace(Args&&... args) {
+			if (_size == _capacity)
+				grow(_capacity*2);
+			T* slot = new (_arr + _size) T(std::forward<Args>(args)...);
 			++_size;
+			return *slot;
 		}
 		void ensure(size_type s) {
-			if (_capacity < s) {
-				_capacity = std::max(s, _capacity*2);
-				_arr = static_cast<T*>(
-					realloc(_arr, sizeof(T)*_capacity));
-			}
+			if (_capacity < s)
+				grow(std::max(s, _capacity*2));
+		}
+		void append(const T* ts, size_type n) {
+			ensure(_size + n);
+			if constexpr (std::is_trivially_copyable_v<T>)
+				memcpy(_arr + _size, ts, sizeof(T)*n);
+			else std::uninitialized_copy(ts, ts + n, _arr + _size);
+			_size += n;
+		}
+		T pop() {
+			T t = std::move(_arr[--_size]);
+			_arr[_size].~T();
+			return t;
 		}
-		T pop() { return _arr[--_size]; }
 		T& operator[](index_type i) { return _arr[i]; }
 		const T& operator[](index_type i) const { return _arr[i]; }
-		void clear() { _size = 0; }
+		void clear() {
+			destroy(0, _size);
+			_size = 0;
+		}
+		// Default-constructs the slots it adds; T must allow that if s > size().
+		void resize(size_type s) {
+			ensure(s);
+			destroy(s, _size);
+			if constexpr (!std::is_trivially_default_constructible_v<T>)
+				for (index_type i = _size; i < s; ++i)
+					new (_arr + i) T();
+			_size = s;
+		}
 
 		size_type size() const { return _size; }
 		size_type capacity() const { return _capacity; }
 
-		~DynamicBag() { free(_arr); }
+		DynamicBag() : _arr(static_cast<T*>(Alloc::allocate(bytes(N), A))) {}
+		~DynamicBag() {
+			destroy(0, _size);
+			Alloc::release(_arr, bytes(_capacity), A);
+		}
 	private:
-		T*			_arr = static_cast<T*>(malloc(sizeof(T) * N));
+		static std::size_t bytes(size_type n) { return sizeof(T)*static_cast<std::size_t>(n); }
+
+		void destroy(index_type from, index_type to) {
+			if constexpr (!std::is_trivially_destructible_v<T>)
+				for (index_type i = from; i < to; ++i)
+					_arr[i].~T();
+		}
+		void grow(size_type capacity) {
+			if constexpr (std::is_trivially_copyable_v<T>)
+				_arr = static_cast<T*>(Alloc::reallocate(_arr, bytes(_capacity), bytes(capacity), A));
+			else if (!Alloc::extend(_arr, bytes(_capacity), bytes(capacity))) {
+				T* arr = static_cast<T*>(Alloc::allocate(bytes(capacity), A));
+				for (index_type i = 0; i < _size; ++i) {
+					new (arr + i) T(std::move(_arr[i]));
+					_arr[i].~T();
+				}
+				Alloc::release(_arr, bytes(_capacity), A);
+				_arr = arr;
+			}
+			_capacity = capacity;
+		}
+
+		T*			_arr;
 		size_type	_size = 0;
 		size_type	_capacity = N;
 	};
-	template <class T, int N>
+	template <class T, int N, size_type A = alignof(T)>
 	class StaticBag
 	{
 	public:
 		void push(const T& t) { _arr[_size++] = t; }
-		T pop() { return _arr[--_size]; }
+		void push(T&& t) { _arr[_size++] = std::move(t); }
+		template <class ...Args>
+		T& emplace(Args&&... args) {
+			T* slot = _arr + _size++;
+			slot->~T();
+			return *new (slot) T(std::forward<Args>(args)...);
+		}
+		void append(const T* ts, size_type n) {
+			if constexpr (std::is_trivially_copyable_v<T>)
+				memcpy(_arr + _size, ts, sizeof(T)*n);
+			else std::copy(ts, ts + n, _arr + _size);
+			_size += n;
+		}
+		T pop() { return std::move(_arr[--_size]); }
 		T& operator[](index_type i) { return _arr[i]; }
 		const T& operator[](index_type i) const { return _arr[i]; }
 		void clear() { _size = 0; }
+		void resize(size_type s) { _size = s; }
 
 		size_type size() const { return _size; }
 		static void ensure(size_type) {}
 	private:
-		T			_arr[N];
-		size_type	_size = 0;
+		alignas(A) T	_arr[N];
+		size_type		_size = 0;
 	};
+	template <class T, int N, size_type A = alignof(T)>
+	using Bag = std::conditional_t<Params.DynamicResize, DynamicBag<T,N,A>, StaticBag<T,N,A>>;
+
+	// Bag of heap objects, deleted with the bag.
 	template <class T, int N>
-	using Bag = std::conditional_t<Params.DynamicResize, DynamicBag<T, N>, StaticBag<T,N>>;
+	struct OwnerBag : Bag<T*,N>
+	{
+		~OwnerBag() {
+			for (index_type i = 0; i < this->size(); ++i)
+				delete (*this)[i];
+		}
+	};
+
+	/**
+	 * Entity-indexed array split into pages of Params.PageBytes, allocated
+	 * on the first write through at(). Pages never written share one page of
+	 * default Ts, so the const operator[] reads anything below ensure()
+	 * without a check and memory follows the indexes in use rather than the
+	 * highest one. The shared page is read-only: the non-const operator[]
+	 * is at(), so reads that may land on unwritten pages go through the
+	 * const one.
+	 */
+	template <class T>
+	class PagedBag : NoCopy
+	{
+		static constexpr size_type log2(size_type n) { return n > 1 ? 1 + log2(n/2) : 0; }
+		static constexpr size_type Shift = log2(std::max<size_type>(Params.PageBytes / sizeof(T), 1));
+		static constexpr size_type PageSize = size_type{1} << Shift;
+		struct Page { T items[PageSize]{}; };
+	public:
+		T& operator[](index_type i) { return at(i); }
+		const T& operator[](index_type i) const { return _pages[i >> Shift]->items[i & (PageSize-1)]; }
+		T& at(index_type i) {
+			ensure(i+1);
+			Page*& page = _pages[i >> Shift];
+			if (page == &_null)
+				page = new Page;
+			return page->items[i & (PageSize-1)];
+		}
+		void ensure(size_type s) {
+			while (_pages.size() << Shift < s)
+				_pages.push(&_null);
+		}
+
+		~PagedBag() {
+			for (index_type i = 0; i < _pages.size(); ++i)
+				if (_pages[i] != &_null)
+					delete _pages[i];
+		}
+	private:
+		// Shared by every World, even with BAGEL_THREAD_WORLDS, as it is
+		// never written.
+		static inline Page	_null;
+		Bag<Page*,Params.InitialEntities/PageSize+1>	_pages;
+	};
+
+	template <class T>
+	class Span
+	{
+	public:
+		Span(T* data, size_type size) : _data(data), _size(size) {}
+
+		T& operator[](index_type i) const { return _data[i]; }
+		T* data() const { return _data; }
+		size_type size() const { return _size; }
+		T* begin() const { return _data; }
+		T* end() const { return _data + _size; }
+	private:
+		T*			_data;
+		size_type	_size;
+	};
+
+	// T's name as the compiler spells it, e.g. "goldminer::Position".
+	template <class T>
+	std::string_view typeName() {
+#ifdef _MSC_VER
+		std::string_view s = __FUNCSIG__;
+		s = s.substr(s.find("typeName<") + 9);
+		s = s.substr(0, s.rfind(">("));
+		for (std::string_view k : {"struct ", "class ", "enum "})
+			if (s.substr(0, k.size()) == k)
+				s.remove_prefix(k.size());
+#else
+		std::string_view s = __PRETTY_FUNCTION__;
+		s = s.substr(s.find("T = ") + 4);
+		s = s.substr(0, s.find_first_of(";]"));
+#endif
+		return s;
+	}
+
+	/**
+	 * Bytes of a World snapshot (see World::snapshot).
+	 *
+	 * put() and Reader::get() copy trivially copyable values as raw bytes,
+	 * std::string as its length and characters, and other types field by
+	 * field as listed with BAGEL_SERIALIZE. The writer opens a section per
+	 * part of the World, so diff() can name the first part two snapshots
+	 * disagree on, and seal() ends it with a checksum of its bytes.
+	 * Reader::get() throws std::out_of_range rather than read past the end.
+	 * assign() takes bytes written elsewhere, without their sections.
+	 */
+	class Buffer : NoCopy
+	{
+	public:
+		static constexpr index_type Same = -2;
+
+		class Reader
+		{
+		public:
+			explicit Reader(const Buffer& b) : _b(b) {}
+
+			template <class T>
+			void get(T& t) {
+				if constexpr (std::is_trivially_copyable_v<T>)
+					read(&t, sizeof(T));
+				else if constexpr (std::is_same_v<T, std::string>) {
+					size_type n;
+					get(n);
+					need(n);
+					t.resize(n);
+					read(t.data(), n);
+				}
+				else {
+					static_assert(!std::is_void_v<typename Serialized<T>::type>,
+						"list the fields of types not trivially copyable with BAGEL_SERIALIZE");
+					fields(t, typename Serialized<T>::type{});
+				}
+			}
+			template <class T>
+			void get(T* ts, size_type n) {
+				if constexpr (std::is_trivially_copyable_v<T>)
+					read(ts, sizeof(T)*n);
+				else for (index_type i = 0; i < n; ++i)
+					get(ts[i]);
+			}
+		private:
+			template <class T, auto ...Ms>
+			void fields(T& t, FieldList<Ms...>) { (get(t.*Ms), ...); }
+			void need(std::size_t n) const {
+				if (n > static_cast<std::size_t>(_b.size()) - _pos)
+					throw std::out_of_range("Buffer::Reader: read past the end");
+			}
+			void read(void* p, std::size_t n) {
+				need(n);
+				memcpy(p, &_b._bytes[0] + _pos, n);
+				_pos += n;
+			}
+
+			const Buffer&	_b;
+			std::size_t		_pos = 0;
+		};
+
+		template <class T>
+		void put(const T& t) {
+			if constexpr (std::is_trivially_copyable_v<T>)
+				write(&t, sizeof(T));
+			else if constexpr (std::is_same_v<T, std::string>) {
+				put(static_cast<size_type>(t.size()));
+				write(t.data(), t.size());
+			}
+			else {
+				static_assert(!std::is_void_v<typename Serialized<T>::type>,
+					"list the fields of types not trivially copyable with BAGEL_SERIALIZE");
+				fields(t, typename Serialized<T>::type{});
+			}
+		}
+		template <class T>
+		void put(const T* ts, size_type n) {
+			if constexpr (std::is_trivially_copyable_v<T>)
+				write(ts, sizeof(T)*n);
+			else for (index_type i = 0; i < n; ++i)
+				put(ts[i]);
+		}
+		// Starts the part of the World numbered id.
+		void section(index_type id) { _sections.push({_bytes.size(), id}); }
+		void clear() {
+			_bytes.clear();
+			_sections.clear();
+		}
+		size_type size() const { return _bytes.size(); }
+		const std::byte* data() const { return &_bytes[0]; }
+		void assign(const void* p, size_type n) {
+			clear();
+			write(p, n);
+		}
+
+		// Appends the checksum of the bytes so far.
+		void seal() { put(checksum()); }
+		// Whether the buffer ends with the checksum of its other bytes.
+		bool sealed() const {
+			const size_type n = size() - static_cast<size_type>(sizeof(std::uint64_t));
+			if (n < 0)
+				return false;
+			std::uint64_t sum;
+			memcpy(&sum, &_bytes[n], sizeof(sum));
+			return sum == checksum(n);
+		}
+		// Of the first n bytes, all by default.
+		std::uint64_t checksum(size_type n = -1) const {
+			if (n < 0)
+				n = size();
+			std::uint64_t h = 0xcbf29ce484222325;
+			index_type i = 0;
+			for (; i+8 <= n; i += 8) {
+				std::uint64_t w;
+				memcpy(&w, &_bytes[i], 8);
+				h = (h ^ w) * 0x100000001b3;
+				h ^= h >> 29;
+			}
+			for (; i < n; ++i)
+				h = (h ^ std::to_integer<std::uint64_t>(_bytes[i])) * 0x100000001b3;
+			return h;
+		}
+		// Id of the first section where a and b differ, or Same.
+		static index_type diff(const Buffer& a, const Buffer& b) {
+			for (index_type s = 0; s < a._sections.size() || s < b._sections.size(); ++s) {
+				if (s >= a._sections.size() || s >= b._sections.size())
+					return (s < a._sections.size() ? a : b)._sections[s].id;
+				if (a._sections[s].id != b._sections[s].id)
+					return a._sections[s].id;
+				const size_type n = a.end(s) - a._sections[s].offset;
+				if (n != b.end(s) - b._sections[s].offset
+					|| memcmp(&a._bytes[0] + a._sections[s].offset, &b._bytes[0] + b._sections[s].offset, n) != 0)
+					return a._sections[s].id;
+			}
+			return Same;
+		}
+	private:
+		struct Section
+		{
+			size_type	offset;
+			index_type	id;
+		};
+
+		template <class T, auto ...Ms>
+		void fields(const T& t, FieldList<Ms...>) { (put(t.*Ms), ...); }
+		void write(const void* p, std::size_t n) {
+			_bytes.append(static_cast<const std::byte*>(p), static_cast<size_type>(n));
+		}
+		size_type end(index_type s) const {
+			return s+1 < _sections.size() ? _sections[s+1].offset : _bytes.size();
+		}
+
+		DynamicBag<std::byte,4096,alignof(std::max_align_t),MallocAlloc>	_bytes;
+		DynamicBag<Section,64,alignof(Section),MallocAlloc>				_sections;
+	};
+
+	// 64-bit hash of len bytes at key, after wyhash (final version 4, by
+	// Wang Yi, public domain).
+	inline std::uint64_t wyhash(const void* key, std::size_t len, std::uint64_t seed = 0) {
+		constexpr std::uint64_t s[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+		const auto mum = [](std::uint64_t& a, std::uint64_t& b) {
+#ifdef __SIZEOF_INT128__
+			const unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+			a = static_cast<std::uint64_t>(r);
+			b = static_cast<std::uint64_t>(r >> 64);
+#else
+			const std::uint64_t ha = a >> 32, hb = b >> 32, la = a & 0xffffffff, lb = b & 0xffffffff;
+			const std::uint64_t rm0 = ha*lb, rm1 = hb*la, rl = la*lb, t = rl + (rm0 << 32);
+			const std::uint64_t lo = t + (rm1 << 32);
+			b = ha*hb + (rm0 >> 32) + (rm1 >> 32) + (t < rl) + (lo < t);
+			a = lo;
+#endif
+		};
+		const auto mix = [&](std::uint64_t a, std::uint64_t b) { mum(a, b); return a ^ b; };
+		const auto r8 = [](const std::uint8_t* p) { std::uint64_t v; memcpy(&v, p, 8); return v; };
+		const auto r4 = [](const std::uint8_t* p) { std::uint32_t v; memcpy(&v, p, 4); return std::uint64_t{v}; };
+
+		const std::uint8_t* p = static_cast<const std::uint8_t*>(key);
+		seed ^= mix(seed ^ s[0], s[1]);
+		std::uint64_t a, b;
+		if (len <= 16) {
+			if (len >= 4) {
+				a = (r4(p) << 32) | r4(p + ((len >> 3) << 2));
+				b = (r4(p + len - 4) << 32) | r4(p + len - 4 - ((len >> 3) << 2));
+			}
+			else if (len > 0) {
+				a = (std::uint64_t{p[0]} << 16) | (std::uint64_t{p[len >> 1]} << 8) | p[len-1];
+				b = 0;
+			}
+			else a = b = 0;
+		}
+		else {
+			std::size_t i = len;
+			if (i > 48) {
+				std::uint64_t see1 = seed, see2 = seed;
+				do {
+					seed = mix(r8(p) ^ s[1], r8(p+8) ^ seed);
+					see1 = mix(r8(p+16) ^ s[2], r8(p+24) ^ see1);
+					see2 = mix(r8(p+32) ^ s[3], r8(p+40) ^ see2);
+					p += 48;
+					i -= 48;
+				} while (i > 48);
+				seed ^= see1 ^ see2;
+			}
+			for (; i > 16; i -= 16, p += 16)
+				seed = mix(r8(p) ^ s[1], r8(p+8) ^ seed);
+			a = r8(p + i - 16);
+			b = r8(p + i - 8);
+		}
+		a ^= s[1];
+		b ^= seed;
+		mum(a, b);
+		return mix(a ^ s[0] ^ len, b ^ s[1]);
+	}
+
+	using symbol_type = std::uint32_t;
+
+	/**
+	 * String interner. Each distinct string is copied once, NUL-terminated,
+	 * into arena chunks that never move, and named by a symbol that stays
+	 * valid for the life of the World's thread, across World::reset and
+	 * restore: snapshots hold symbols, not text. Symbol 0 is the empty
+	 * string. Lookups hash with wyhash into an open-addressing table kept
+	 * at most half full. intern() must not run inside parallelEach.
+	 */
+	class Strings final : NoInstance
+	{
+	public:
+		struct Stats
+		{
+			size_type	count;		// distinct non-empty strings
+			std::size_t	bytes;		// their characters and terminators
+			std::size_t	reserved;	// arena, entry and table bytes allocated
+		};
+
+		static symbol_type intern(std::string_view s) {
+			if (s.empty())
+				return 0;
+			const std::uint64_t h = wyhash(s.data(), s.size());
+			if (2*(_entries.size()+1) > _table.size())
+				rehash(std::max<size_type>(64, 2*_table.size()));
+			index_type i = static_cast<index_type>(h & (_table.size()-1));
+			for (; _table[i] != 0; i = (i+1) & (_table.size()-1)) {
+				const Entry& e = _entries[_table[i]-1];
+				if (e.hash == static_cast<std::uint32_t>(h) && e.size == s.size() && memcmp(e.str, s.data(), s.size()) == 0)
+					return _table[i];
+			}
+			_entries.push({store(s), static_cast<std::uint32_t>(s.size()), static_cast<std::uint32_t>(h)});
+			_bytes += s.size() + 1;
+			return _table[i] = static_cast<symbol_type>(_entries.size());
+		}
+		static std::string_view view(symbol_type sym) {
+			if (sym == 0)
+				return {};
+			return {_entries[sym-1].str, _entries[sym-1].size};
+		}
+		static const char* c_str(symbol_type sym) { return sym == 0 ? "" : _entries[sym-1].str; }
+
+		static Stats stats() {
+			return {_entries.size(), _bytes, _arena.reserved
+				+ sizeof(Entry)*static_cast<std::size_t>(_entries.capacity())
+				+ sizeof(symbol_type)*static_cast<std::size_t>(_table.size())};
+		}
+	private:
+		static constexpr std::size_t ChunkBytes = 64*1024;
+
+		struct Entry
+		{
+			const char*		str;
+			std::uint32_t	size;
+			std::uint32_t	hash;	// low bits of the wyhash
+		};
+		struct Arena : NoCopy
+		{
+			DynamicBag<char*,16,alignof(char*),MallocAlloc>	blocks;
+			char*		chunk;		// being filled
+			std::size_t	used;		// of chunk
+			std::size_t	reserved;
+
+			char* allocate(std::size_t n) {
+				char* p = static_cast<char*>(malloc(n));
+				blocks.push(p);
+				reserved += n;
+				return p;
+			}
+			Arena() : chunk(nullptr), used(0), reserved(0) {}
+			~Arena() {
+				for (index_type i = 0; i < blocks.size(); ++i)
+					free(blocks[i]);
+			}
+		};
+
+		// Copies s into the arena; long strings get a block of their own.
+		static const char* store(std::string_view s) {
+			const std::size_t n = s.size() + 1;
+			char* p;
+			if (n > ChunkBytes / 4)
+				p = _arena.allocate(n);
+			else {
+				if (!_arena.chunk || _arena.used + n > ChunkBytes) {
+					_arena.chunk = _arena.allocate(ChunkBytes);
+					_arena.used = 0;
+				}
+				p = _arena.chunk + _arena.used;
+				_arena.used += n;
+			}
+			memcpy(p, s.data(), s.size());
+			p[s.size()] = '\0';
+			return p;
+		}
+		static void rehash(size_type size) {
+			_table.resize(size);
+			std::fill(&_table[0], &_table[0] + size, symbol_type{0});
+			for (index_type s = 0; s < _entries.size(); ++s) {
+				index_type i = static_cast<index_type>(_entries[s].hash & (size-1));
+				while (_table[i] != 0)
+					i = (i+1) & (size-1);
+				_table[i] = static_cast<symbol_type>(s+1);
+			}
+		}
+
+		static inline BAGEL_PER_WORLD Arena	_arena;
+		static inline BAGEL_PER_WORLD DynamicBag<Entry,64,alignof(Entry),MallocAlloc>	_entries;
+		static inline BAGEL_PER_WORLD DynamicBag<symbol_type,64,alignof(symbol_type),MallocAlloc>	_table;	// symbols, 0 if free
+		static inline BAGEL_PER_WORLD std::size_t	_bytes = 0;
+	};
+
+	template <class>
+	struct member_traits;
+	template <class C, class F>
+	struct member_traits<F C::*> { using class_type = C; using type = F; };
+	template <auto M>
+	using member_t = typename member_traits<decltype(M)>::type;
+	template <auto M>
+	using class_of_t = typename member_traits<decltype(M)>::class_type;
+	template <auto M, class>
+	struct is_listed;
+	template <auto M, auto ...Ms>
+	struct is_listed<M, FieldList<Ms...>> : std::bool_constant<(std::is_same_v<FieldList<M>, FieldList<Ms>> || ...)> {};
 
 	template <class T>
 	class SparseStorage final : NoInstance
 	{
 	public:
-		static void add(ent_type e, const T& t) {
-			_bag.ensure(e.id);
-			_bag[e.id] = t;
+		static void add(ent_type e, const T& t) { _bag.at(e.index()) = t; }
+		// Batch add; call reserve first (see World::addComponents).
+		static void add(Span<ent_type> ents, const T* ts) {
+			for (index_type i = 0; i < ents.size(); ++i)
+				_bag.at(ents[i].index()) = ts[i];
 		}
+		// Room for n more components on entity indexes below ids.
+		static void reserve(size_type, id_type ids) { _bag.ensure(ids); }
 		static void del(ent_type) {}
-		static T& get(ent_type e) { return _bag[e.id]; }
+		static void clear() {}
+		static T& get(ent_type e) { return _bag[e.index()]; }
+
+		static void load(Buffer::Reader& r, ent_type e) { r.get(_bag.at(e.index())); }
 	private:
-		static inline Bag<T,Params.InitialEntities> _bag;
+		static inline BAGEL_PER_WORLD PagedBag<T> _bag;
 	};
 	template <class T>
 	class PackedStorage final : NoInstance
 	{
 	public:
 		static void add(ent_type e, const T& t) {
-			_entToComp.ensure(e.id);
-			_entToComp[e.id] = _comps.size();
+			_entToComp.at(e.index()) = _comps.size();
 			_comps.push(t);
 			_compToEnt.push(e);
 		}
+		static void add(Span<ent_type> ents, const T* ts) {
+			for (index_type i = 0; i < ents.size(); ++i)
+				_entToComp.at(ents[i].index()) = _comps.size() + i;
+			_comps.append(ts, ents.size());
+			_compToEnt.append(ents.data(), ents.size());
+		}
+		static void reserve(size_type n, id_type ids) {
+			_comps.ensure(_comps.size() + n);
+			_compToEnt.ensure(_compToEnt.size() + n);
+			_entToComp.ensure(ids);
+		}
+		static void swap(index_type a, index_type b) {
+			std::swap(_comps[a], _comps[b]);
+			std::swap(_compToEnt[a], _compToEnt[b]);
+			_entToComp[_compToEnt[a].index()] = a;
+			_entToComp[_compToEnt[b].index()] = b;
+		}
 		static void del(ent_type e) {
-			index_type ent_comp_idx = _entToComp[e.id];
+			index_type ent_comp_idx = _entToComp[e.index()];
 			ent_type last_ent = _compToEnt.pop();
 
 			_comps[ent_comp_idx] = _comps.pop();
 			_compToEnt[ent_comp_idx] = last_ent;
-			_entToComp[last_ent.id] = ent_comp_idx;
+			_entToComp[last_ent.index()] = ent_comp_idx;
+		}
+		static void clear() {
+			_comps.clear();
+			_compToEnt.clear();
 		}
 		static T& get(ent_type e) {
-			return _comps[_entToComp[e.id]];
+			return _comps[std::as_const(_entToComp)[e.index()]];
 		}
 		static int size() { return _comps.size(); }
 		static T& get(index_type idx) {
 			return _comps[idx];
 		}
+		static index_type indexOf(ent_type e) { return std::as_const(_entToComp)[e.index()]; }
 		static ent_type entity(index_type idx) {
 			return _compToEnt[idx];
 		}
+
+		static void save(Buffer& b) {
+			b.put(size());
+			b.put(&_comps[0], size());
+			b.put(&_compToEnt[0], size());
+		}
+		static void load(Buffer::Reader& r, id_type ids) {
+			size_type n;
+			r.get(n);
+			_comps.resize(n);
+			r.get(&_comps[0], n);
+			_compToEnt.resize(n);
+			r.get(&_compToEnt[0], n);
+			_entToComp.ensure(ids);
+			for (index_type i = 0; i < n; ++i)
+				_entToComp.at(_compToEnt[i].index()) = i;
+		}
 	private:
-		static inline Bag<T,Params.InitialPackedSize>			_comps;
-		static inline Bag<index_type,Params.InitialEntities>	_entToComp;
-		static inline Bag<ent_type,Params.InitialPackedSize>	_compToEnt;
+		static inline BAGEL_PER_WORLD Bag<T,Params.InitialPackedSize>			_comps;
+		static inline BAGEL_PER_WORLD PagedBag<index_type>	_entToComp;
+		static inline BAGEL_PER_WORLD Bag<ent_type,Params.InitialPackedSize>	_compToEnt;
 	};
 	template <class T>
 	class TaggedStorage final : NoInstance
 	{
 	public:
 		static void add(ent_type, const T&) {}
+		static void add(Span<ent_type>, const T*) {}
+		static void reserve(size_type, id_type) {}
 		static void del(ent_type) {}
+		static void clear() {}
 		static T& get(ent_type) = delete;
 	};
-
+	// Tag storage that also lists its entities (a sparse set without payload),
+	// so tags can drive views and be enumerated with size()/entity(i).
 	template <class T>
-	struct Storage final : NoInstance {
-		using type = SparseStorage<T>;
+	class TagSetStorage final : NoInstance
+	{
+		static_assert(std::is_empty_v<T>, "TagSetStorage holds empty types only");
+	public:
+		static void add(ent_type e, const T&) {
+			_entToSlot.at(e.index()) = _ents.size();
+			_ents.push(e);
+		}
+		static void add(Span<ent_type> ents, const T*) {
+			for (index_type i = 0; i < ents.size(); ++i)
+				_entToSlot.at(ents[i].index()) = _ents.size() + i;
+			_ents.append(ents.data(), ents.size());
+		}
+		static void reserve(size_type n, id_type ids) {
+			_ents.ensure(_ents.size() + n);
+			_entToSlot.ensure(ids);
+		}
+		static void del(ent_type e) {
+			const index_type slot = _entToSlot[e.index()];
+			const ent_type last = _ents.pop();
+			_ents[slot] = last;
+			_entToSlot[last.index()] = slot;
+		}
+		static void clear() { _ents.clear(); }
+		static T& get(ent_type) = delete;
+		static int size() { return _ents.size(); }
+		static index_type indexOf(ent_type e) { return std::as_const(_entToSlot)[e.index()]; }
+		static ent_type entity(index_type idx) { return _ents[idx]; }
+
+		static void save(Buffer& b) {
+			b.put(size());
+			b.put(&_ents[0], size());
+		}
+		static void load(Buffer::Reader& r, id_type ids) {
+			size_type n;
+			r.get(n);
+			_ents.resize(n);
+			r.get(&_ents[0], n);
+			_entToSlot.ensure(ids);
+			for (index_type i = 0; i < n; ++i)
+				_entToSlot.at(_ents[i].index()) = i;
+		}
+	private:
+		static inline BAGEL_PER_WORLD PagedBag<index_type>	_entToSlot;
+		static inline BAGEL_PER_WORLD Bag<ent_type,Params.InitialPackedSize>	_ents;
 	};
 
-	class SingleMask final
+	/**
+	 * Flyweight storage for read-only values repeated across many entities:
+	 * each distinct value is kept once and every entity holds a 16-bit handle
+	 * to it, so at most 65536 distinct values; adding one more throws
+	 * std::length_error. Values are compared bytewise, found by their wyhash
+	 * in an open-addressing table, and stay until World::reset.
+	 * get() returns the shared value, which must not be written; add the new
+	 * value instead.
+	 */
+	template <class T>
+	class SharedStorage final : NoInstance
 	{
+		static_assert(std::is_trivially_copyable_v<T>, "SharedStorage compares values bytewise");
 	public:
-		using bit_type = mask_type;
-		static constexpr bit_type bit(index_type idx) { return 1<<idx; }
+		using handle_type = std::uint16_t;
 
-		void set(const bit_type b) { _mask |= b; }
+		static void add(ent_type e, const T& t) { _handles.at(e.index()) = intern(t); }
+		static void add(Span<ent_type> ents, const T* ts) {
+			for (index_type i = 0; i < ents.size(); ++i)
+				add(ents[i], ts[i]);
+		}
+		static void reserve(size_type, id_type ids) { _handles.ensure(ids); }
+		static void del(ent_type) {}
+		static void clear() {
+			_values.clear();
+			_table.clear();
+		}
+		static const T& get(ent_type e) { return _values[std::as_const(_handles)[e.index()]]; }
 
-		void clear(const bit_type b) { _mask &= ~b; }
-		void clear() { _mask = 0; }
+		static size_type values() { return _values.size(); }
+		static handle_type handle(ent_type e) { return std::as_const(_handles)[e.index()]; }
+		static const T& value(index_type h) { return _values[h]; }
 
-		bool test(const bit_type b) const { return _mask & b; }
-		bool test(const SingleMask m) const { return (_mask & m._mask) == m._mask; }
+		static void load(Buffer::Reader& r, ent_type e) {
+			T t;
+			r.get(t);
+			add(e, t);
+		}
 	private:
-		mask_type	_mask{0};
+		friend class SharedSetStorage<T>;
+
+		static constexpr size_type MaxValues = size_type{std::numeric_limits<handle_type>::max()} + 1;
+
+		static handle_type intern(const T& t) {
+			if (2*(values()+1) > _table.size())
+				rehash();
+			index_type i = slot(t);
+			for (; _table[i] != 0; i = (i+1) & (_table.size()-1))
+				if (memcmp(&_values[_table[i]-1], &t, sizeof(T)) == 0)
+					return static_cast<handle_type>(_table[i]-1);
+			if (values() == MaxValues)
+				throw std::length_error("SharedStorage: more than 65536 distinct values");
+			_values.push(t);
+			_table[i] = values();
+			return static_cast<handle_type>(values()-1);
+		}
+		static index_type slot(const T& t) { return static_cast<index_type>(wyhash(&t, sizeof(T)) & (_table.size()-1)); }
+		// Rebuilds the table from _values, at most half full with one more.
+		static void rehash() {
+			size_type size = 64;
+			while (size < 2*(values()+1))
+				size *= 2;
+			_table.resize(size);
+			std::fill(&_table[0], &_table[0] + size, size_type{0});
+			for (index_type h = 0; h < values(); ++h) {
+				index_type i = slot(_values[h]);
+				while (_table[i] != 0)
+					i = (i+1) & (size-1);
+				_table[i] = h+1;
+			}
+		}
+
+		static inline BAGEL_PER_WORLD Bag<T,Params.InitialPackedSize>	_values;
+		static inline BAGEL_PER_WORLD DynamicBag<size_type,64,alignof(size_type),MallocAlloc>	_table;	// handles+1, 0 if free
+		static inline BAGEL_PER_WORLD PagedBag<handle_type>				_handles;
 	};
-	class MultiMask final
+	// Shared storage that also lists its entities, dense and partitioned by
+	// value in handle order: views driven by it walk them grouped by value,
+	// and entities(h) lists the ones sharing value(h). Adding or removing
+	// moves one entity per later value. Cannot be owned by a group.
+	template <class T>
+	class SharedSetStorage final : NoInstance
 	{
+		using Shared = SharedStorage<T>;
 	public:
-		using bit_type = struct {
-			const index_type	index;
-			const mask_type		mask;
-		};
-		static constexpr bit_type bit(index_type idx) {
-			return {idx/BitsetWidth, static_cast<mask_type>(1<<(idx%BitsetWidth))};
+		static void add(ent_type e, const T& t) {
+			Shared::add(e, t);
+			const index_type h = Shared::handle(e);
+			if (_ends.size() < Shared::values())
+				_ends.push(size());
+			index_type pos = _ents.size();
+			_ents.push(e);
+			// Each later value hands its first entity to the slot after its end.
+			for (index_type v = Shared::values()-1; v > h; --v) {
+				const index_type first = _ends[v-1];
+				if (first != pos)
+					place(_ents[first], pos);
+				++_ends[v];
+				pos = first;
+			}
+			place(e, pos);
+			++_ends[h];
 		}
+		static void add(Span<ent_type> ents, const T* ts) {
+			for (index_type i = 0; i < ents.size(); ++i)
+				add(ents[i], ts[i]);
+		}
+		static void reserve(size_type n, id_type ids) {
+			Shared::reserve(n, ids);
+			_ents.ensure(_ents.size() + n);
+			_slots.ensure(ids);
+		}
+		static void del(ent_type e) {
+			index_type hole = _slots[e.index()];
+			// Each value from e's on fills the hole with its last entity.
+			for (index_type v = Shared::handle(e); v < Shared::values(); ++v) {
+				const index_type last = --_ends[v];
+				if (last != hole)
+					place(_ents[last], hole);
+				hole = last;
+			}
+			_ents.pop();
+		}
+		static void clear() {
+			Shared::clear();
+			_ends.clear();
+			_ents.clear();
+		}
+		static const T& get(ent_type e) { return Shared::get(e); }
+		static int size() { return _ents.size(); }
+		static index_type indexOf(ent_type e) { return std::as_const(_slots)[e.index()]; }
+		static ent_type entity(index_type idx) { return _ents[idx]; }
 
-		void set(const bit_type& b) { _masks[b.index] |= b.mask; }
-
-		void clear(const bit_type& b) { _masks[b.index] &= ~b.mask; }
-		void clear() { memset(_masks, 0, sizeof(_masks)); }
+		static size_type values() { return Shared::values(); }
+		static const T& value(index_type h) { return Shared::value(h); }
+		static Span<ent_type> entities(index_type h) {
+			const index_type begin = h > 0 ? _ends[h-1] : 0;
+			return {&_ents[begin], _ends[h] - begin};
+		}
 
-		bool test(const bit_type& b) const { return _masks[b.index] & b.mask; }
-		bool test(const MultiMask& m) const {
-			for (index_type i = 0; i < Size; ++i)
-				if ((_masks[i] & m._masks[i]) != m._masks[i])
-					return false;
-			return true;
+		static void save(Buffer& b) {
+			b.put(Shared::values());
+			b.put(&Shared::_values[0], Shared::values());
+			b.put(&_ends[0], Shared::values());
+			b.put(size());
+			b.put(&_ents[0], size());
+		}
+		static void load(Buffer::Reader& r, id_type ids) {
+			size_type n;
+			r.get(n);
+			Shared::_values.resize(n);
+			r.get(&Shared::_values[0], n);
+			Shared::rehash();
+			_ends.resize(n);
+			r.get(&_ends[0], n);
+			r.get(n);
+			_ents.resize(n);
+			r.get(&_ents[0], n);
+			reserve(0, ids);
+			for (index_type h = 0, i = 0; h < Shared::values(); ++h)
+				for (; i < _ends[h]; ++i) {
+					_slots.at(_ents[i].index()) = i;
+					Shared::_handles.at(_ents[i].index()) = static_cast<typename Shared::handle_type>(h);
+				}
 		}
 	private:
-		static constexpr size_type	Size = (Params.MaxComponents-1)/BitsetWidth + 1;
-		mask_type					_masks[Size] ={};
+		static void place(ent_type e, index_type pos) {
+			_ents[pos] = e;
+			_slots.at(e.index()) = pos;
+		}
+
+		static inline BAGEL_PER_WORLD Bag<index_type,Params.InitialPackedSize>	_ends;
+		static inline BAGEL_PER_WORLD Bag<ent_type,Params.InitialPackedSize>	_ents;
+		static inline BAGEL_PER_WORLD PagedBag<index_type>	_slots;
 	};
-	using Mask = std::conditional_t<Params.MaxComponents<=BitsetWidth, SingleMask, MultiMask>;
 
-	static inline index_type compCounter = -1;
-	template <class>
+	/**
+	 * Dense storage splitting T into one column per field listed with
+	 * BAGEL_FIELDS, each aligned to SimdAlign for vector loads. Fields also
+	 * listed with BAGEL_COLD go to side tables indexed by entity instead, so
+	 * walks, swaps and removals never touch them.
+	 *
+	 * get() returns a Ref proxy that converts to/from T; column<&T::f>()
+	 * exposes a hot field as a contiguous Span ordered like entity(i).
+	 */
+	constexpr inline size_type SimdAlign = 64;
+
+	template <class T, auto ...Ms>
+	class SoAStorage<T, FieldList<Ms...>> final : NoInstance
+	{
+		template <auto M>
+		static constexpr bool IsCold = is_listed<M, typename Cold<T>::type>::value;
+		template <auto M>
+		struct Column {
+			std::conditional_t<IsCold<M>, PagedBag<member_t<M>>,
+				Bag<member_t<M>,Params.InitialPackedSize,SimdAlign>> bag;
+		};
+	public:
+		class Ref
+		{
+		public:
+			explicit Ref(index_type idx) : _idx(idx) {}
+			explicit operator bool() const { return _idx >= 0; }
+
+			operator T() const {
+				T t{};
+				((t.*Ms = field<Ms>(_idx)), ...);
+				return t;
+			}
+			const Ref& operator=(const T& t) const {
+				((field<Ms>(_idx) = t.*Ms), ...);
+				return *this;
+			}
+			template <auto M>
+			member_t<M>& get() const { return field<M>(_idx); }
+		private:
+			index_type _idx;
+		};
+
+		static void add(ent_type e, const T& t) {
+			_entToComp.at(e.index()) = _compToEnt.size();
+			(push<Ms>(e, t.*Ms), ...);
+			_compToEnt.push(e);
+		}
+		static void add(Span<ent_type> ents, const T* ts) {
+			for (index_type i = 0; i < ents.size(); ++i) {
+				_entToComp.at(ents[i].index()) = _compToEnt.size() + i;
+				(push<Ms>(ents[i], ts[i].*Ms), ...);
+			}
+			_compToEnt.append(ents.data(), ents.size());
+		}
+		static void reserve(size_type n, id_type ids) {
+			(col<Ms>().ensure(IsCold<Ms> ? ids : size() + n), ...);
+			_compToEnt.ensure(size() + n);
+			_entToComp.ensure(ids);
+		}
+		static void swap(index_type a, index_type b) {
+			(swap<Ms>(a, b), ...);
+			std::swap(_compToEnt[a], _compToEnt[b]);
+			_entToComp[_compToEnt[a].index()] = a;
+			_entToComp[_compToEnt[b].index()] = b;
+		}
+		static void del(ent_type e) {
+			index_type ent_comp_idx = _entToComp[e.index()];
+			(pop<Ms>(e, ent_comp_idx), ...);
+			ent_type last_ent = _compToEnt.pop();
+			_compToEnt[ent_comp_idx] = last_ent;
+			_entToComp[last_ent.index()] = ent_comp_idx;
+		}
+		static void clear() {
+			(clearField<Ms>(), ...);
+			_compToEnt.clear();
+		}
+		static Ref get(ent_type e) { return Ref{std::as_const(_entToComp)[e.index()]}; }
+		static int size() { return _compToEnt.size(); }
+		static Ref get(index_type idx) { return Ref{idx}; }
+		static index_type indexOf(ent_type e) { return std::as_const(_entToComp)[e.index()]; }
+		static ent_type entity(index_type idx) {
+			return _compToEnt[idx];
+		}
+		template <auto M>
+		static Span<member_t<M>> column() {
+			static_assert(!IsCold<M>, "cold fields have no column");
+			return {&col<M>()[0], size()};
+		}
+
+		// The entities, then each field in entity(i) order.
+		static void save(Buffer& b) {
+			b.put(size());
+			b.put(&_compToEnt[0], size());
+			(saveField<Ms>(b), ...);
+		}
+		static void load(Buffer::Reader& r, id_type ids) {
+			size_type n;
+			r.get(n);
+			_compToEnt.resize(n);
+			r.get(&_compToEnt[0], n);
+			_entToComp.ensure(ids);
+			for (index_type i = 0; i < n; ++i)
+				_entToComp.at(_compToEnt[i].index()) = i;
+			(loadField<Ms>(r, ids), ...);
+		}
+	private:
+		template <auto M>
+		static auto& col() { return std::get<Column<M>>(_cols).bag; }
+		template <auto M>
+		static member_t<M>& field(index_type idx) {
+			if constexpr (IsCold<M>)
+				return col<M>()[_compToEnt[idx].index()];
+			else return col<M>()[idx];
+		}
+		template <auto M>
+		static void push(ent_type e, const member_t<M>& v) {
+			if constexpr (IsCold<M>)
+				col<M>().at(e.index()) = v;
+			else col<M>().push(v);
+		}
+		template <auto M>
+		static void swap(index_type a, index_type b) {
+			if constexpr (!IsCold<M>)
+				std::swap(col<M>()[a], col<M>()[b]);
+		}
+		// Drops e's field M, at idx: the last entry fills a column's hole,
+		// while side tables only release what the field holds.
+		template <auto M>
+		static void pop(ent_type e, index_type idx) {
+			if constexpr (!IsCold<M>)
+				col<M>()[idx] = col<M>().pop();
+			else if constexpr (!std::is_trivially_destructible_v<member_t<M>>)
+				col<M>()[e.index()] = member_t<M>{};
+		}
+		template <auto M>
+		static void clearField() {
+			if constexpr (!IsCold<M>)
+				col<M>().clear();
+			else if constexpr (!std::is_trivially_destructible_v<member_t<M>>)
+				for (index_type i = 0; i < size(); ++i)
+					col<M>()[_compToEnt[i].index()] = member_t<M>{};
+		}
+		template <auto M>
+		static void saveField(Buffer& b) {
+			if constexpr (IsCold<M>)
+				for (index_type i = 0; i < size(); ++i)
+					b.put(field<M>(i));
+			else b.put(&col<M>()[0], size());
+		}
+		template <auto M>
+		static void loadField(Buffer::Reader& r, id_type ids) {
+			if constexpr (IsCold<M>) {
+				col<M>().ensure(ids);
+				for (index_type i = 0; i < size(); ++i)
+					r.get(col<M>().at(_compToEnt[i].index()));
+			}
+			else {
+				col<M>().resize(size());
+				r.get(&col<M>()[0], size());
+			}
+		}
+
+		static inline BAGEL_PER_WORLD std::tuple<Column<Ms>...>					_cols;
+		static inline BAGEL_PER_WORLD PagedBag<index_type>	_entToComp;
+		static inline BAGEL_PER_WORLD Bag<ent_type,Params.InitialPackedSize>	_compToEnt;
+	};
+
+	template <class T>
+	struct Storage final : NoInstance {
+		using type = SparseStorage<T>;
+	};
+
+	class SingleMask final
+	{
+	public:
+		using bit_type = mask_type;
+		static constexpr bit_type bit(index_type idx) { return bit_type{1}<<idx; }
+
+		void set(const bit_type b) { _mask |= b; }
+
+		void clear(const bit_type b) { _mask &= ~b; }
+		void clear() { _mask = 0; }
+
+		bool test(const bit_type b) const { return _mask & b; }
+		bool test(const SingleMask m) const { return (_mask & m._mask) == m._mask; }
+		bool any(const SingleMask m) const { return _mask & m._mask; }
+		bool operator==(const SingleMask m) const { return _mask == m._mask; }
+		SingleMask& operator|=(const SingleMask m) { _mask |= m._mask; return *this; }
+	private:
+		mask_type	_mask{0};
+	};
+
+	/**
+	 * Mask of N components stored as 64-bit words.
+	 * Whole-mask operations compare 4 words per instruction with AVX2, or 2
+	 * with SSE2, depending on the target the translation unit is built for.
+	 */
+	template <int N>
+	class MultiMask final
+	{
+		using word_type = std::uint64_t;
+		static constexpr size_type	WordBits = 64;
+		static constexpr size_type	Size = (N-1)/WordBits + 1;
+	public:
+		using bit_type = struct {
+			const index_type	index;
+			const word_type		mask;
+		};
+		static constexpr bit_type bit(index_type idx) {
+			return {idx/WordBits, word_type{1}<<(idx%WordBits)};
+		}
+
+		void set(const bit_type& b) { _masks[b.index] |= b.mask; }
+
+		void clear(const bit_type& b) { _masks[b.index] &= ~b.mask; }
+		void clear() { memset(_masks, 0, sizeof(_masks)); }
+
+		bool test(const bit_type& b) const { return _masks[b.index] & b.mask; }
+		// Branch-free: missing bits of all words are combined, then tested once.
+		bool test(const MultiMask& m) const {
+			index_type i = 0;
+			word_type miss = 0;
+#if defined(__AVX2__)
+			__m256i miss256 = _mm256_setzero_si256();
+			for (; i+4 <= Size; i += 4)
+				miss256 = _mm256_or_si256(miss256, _mm256_andnot_si256(load256(_masks+i), load256(m._masks+i)));
+			if (!_mm256_testz_si256(miss256, miss256))
+				return false;
+#elif defined(__SSE2__)
+			__m128i miss128 = _mm_setzero_si128();
+			for (; i+2 <= Size; i += 2)
+				miss128 = _mm_or_si128(miss128, _mm_andnot_si128(load128(_masks+i), load128(m._masks+i)));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(miss128, _mm_setzero_si128())) != 0xFFFF)
+				return false;
+#endif
+			for (; i < Size; ++i)
+				miss |= m._masks[i] & ~_masks[i];
+			return miss == 0;
+		}
+		bool any(const MultiMask& m) const {
+			word_type common = 0;
+			for (index_type i = 0; i < Size; ++i)
+				common |= _masks[i] & m._masks[i];
+			return common != 0;
+		}
+		bool operator==(const MultiMask& m) const {
+			return memcmp(_masks, m._masks, sizeof(_masks)) == 0;
+		}
+		MultiMask& operator|=(const MultiMask& m) {
+			index_type i = 0;
+#if defined(__AVX2__)
+			for (; i+4 <= Size; i += 4)
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(_masks+i),
+					_mm256_or_si256(load256(_masks+i), load256(m._masks+i)));
+#elif defined(__SSE2__)
+			for (; i+2 <= Size; i += 2)
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(_masks+i),
+					_mm_or_si128(load128(_masks+i), load128(m._masks+i)));
+#endif
+			for (; i < Size; ++i)
+				_masks[i] |= m._masks[i];
+			return *this;
+		}
+	private:
+#if defined(__AVX2__)
+		static __m256i load256(const word_type* p) {
+			return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		}
+#endif
+#if defined(__SSE2__)
+		static __m128i load128(const word_type* p) {
+			return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		}
+#endif
+
+		alignas(32) word_type	_masks[Size] = {};
+	};
+	using Mask = std::conditional_t<Params.MaxComponents<=BitsetWidth, SingleMask, MultiMask<Params.MaxComponents>>;
+
+	template <class S, class = void>
+	struct is_dense : std::false_type {};
+	template <class S>
+	struct is_dense<S, std::void_t<decltype(S::size()), decltype(S::entity(0))>> : std::true_type {};
+	template <class T>
+	constexpr inline bool is_dense_v = is_dense<typename Storage<T>::type>::value;
+
+	inline index_type compCounter = -1;
+	template <class>
 	struct Component final : NoInstance
 	{
 		static inline const index_type		Index = ++compCounter;
 		static inline const Mask::bit_type	Bit = Mask::bit(Index);
 	};
 
+	template <class>
+	struct MakeRegistry;
+	template <int ...Is>
+	struct MakeRegistry<std::integer_sequence<int,Is...>> {
+		using type = TypeList<typename Registered<Is>::type...>;
+	};
+	using Components = typename MakeRegistry<std::make_integer_sequence<int,RegisteredCount>>::type;
+
+	/**
+	 * Archetype tables backing ChunkedStorage.
+	 *
+	 * Entities with the same set of chunked components share an archetype,
+	 * whose rows live in fixed-size chunks (Params.ChunkSize) holding the
+	 * owning entities followed by one column per component.
+	 * Adding or removing a chunked component moves the entity's row to the
+	 * matching archetype; removal fills the hole with the archetype's last row.
+	 */
+	class Archetypes final : NoInstance
+	{
+	public:
+		struct Column
+		{
+			size_type	size;
+			size_type	align;
+			void		(*construct)(void* dst, const void* src);
+			void		(*relocate)(void* dst, void* src);
+			void		(*destroy)(void* p);
+		};
+		template <class T>
+		static const Column* column() {
+			static constexpr Column c{
+				sizeof(T), alignof(T),
+				[](void* dst, const void* src) { new (dst) T(*static_cast<const T*>(src)); },
+				[](void* dst, void* src) {
+					new (dst) T(std::move(*static_cast<T*>(src)));
+					static_cast<T*>(src)->~T();
+				},
+				[](void* p) { static_cast<T*>(p)->~T(); }
+			};
+			return &c;
+		}
+
+		class Archetype;
+		struct Row
+		{
+			Archetype*	archetype;
+			index_type	chunk;
+			index_type	slot;
+		};
+
+		class Archetype : NoCopy
+		{
+		public:
+			Archetype(const Mask& sig, const index_type* comps, size_type count)
+				: _sig(sig), _count(count)
+			{
+				std::fill(std::begin(_offsets), std::end(_offsets), -1);
+				std::fill(std::begin(_addEdge), std::end(_addEdge), Unknown);
+				std::fill(std::begin(_delEdge), std::end(_delEdge), Unknown);
+				std::copy(comps, comps+count, _comps);
+
+				size_type rowBytes = sizeof(ent_type);
+				for (index_type i = 0; i < _count; ++i)
+					rowBytes += _columns[_comps[i]]->size;
+				_capacity = std::max(1, Params.ChunkSize / rowBytes);
+				while (_capacity > 1 && layout() > Params.ChunkSize)
+					--_capacity;
+				_chunkBytes = std::max(Params.ChunkSize, layout());
+			}
+			~Archetype() {
+				clear();
+				for (index_type i = 0; i < _chunks.size(); ++i)
+					operator delete(_chunks[i], std::align_val_t{ChunkAlign});
+			}
+
+			const Mask& sig() const { return _sig; }
+			size_type size() const { return _size; }
+			size_type capacity() const { return _capacity; }
+			bool has(index_type comp) const { return _offsets[comp] >= 0; }
+
+			ent_type* entities(index_type chunk) const {
+				return reinterpret_cast<ent_type*>(_chunks[chunk]);
+			}
+			std::byte* column(index_type comp, index_type chunk) const {
+				return _chunks[chunk] + _offsets[comp];
+			}
+			void* at(index_type comp, index_type row) const {
+				return column(comp, row/_capacity) + (row%_capacity)*_columns[comp]->size;
+			}
+			ent_type& entity(index_type row) const {
+				return entities(row/_capacity)[row%_capacity];
+			}
+
+			index_type push(ent_type e) {
+				if (_size == _chunks.size()*_capacity)
+					_chunks.push(static_cast<std::byte*>(
+						operator new(_chunkBytes, std::align_val_t{ChunkAlign})));
+				entity(_size) = e;
+				return _size++;
+			}
+			// Destroys every row, keeping the chunks.
+			void clear() {
+				for (index_type row = 0; row < _size; ++row)
+					for (index_type i = 0; i < _count; ++i)
+						_columns[_comps[i]]->destroy(at(_comps[i], row));
+				_size = 0;
+			}
+			// Fills the (already vacated) row with the last one; returns the moved entity.
+			ent_type erase(index_type row) {
+				const index_type last = --_size;
+				if (row == last)
+					return {-1};
+				for (index_type i = 0; i < _count; ++i)
+					_columns[_comps[i]]->relocate(at(_comps[i], row), at(_comps[i], last));
+				return entity(row) = entity(last);
+			}
+
+		private:
+			friend class Archetypes;
+			static constexpr index_type Unknown = -2;
+			static constexpr size_type ChunkAlign = 64;
+
+			size_type layout() {
+				size_type off = sizeof(ent_type)*_capacity;
+				for (index_type i = 0; i < _count; ++i) {
+					const Column* c = _columns[_comps[i]];
+					off = (off + c->align-1) / c->align * c->align;
+					_offsets[_comps[i]] = off;
+					off += c->size*_capacity;
+				}
+				return off;
+			}
+
+			Mask		_sig;
+			index_type	_comps[Params.MaxComponents];
+			size_type	_count;
+			size_type	_offsets[Params.MaxComponents];
+			index_type	_addEdge[Params.MaxComponents];
+			index_type	_delEdge[Params.MaxComponents];
+			size_type	_capacity = 1;
+			size_type	_chunkBytes = 0;
+			size_type	_size = 0;
+			Bag<std::byte*,Params.InitialEntities>	_chunks;
+		};
+
+		static void add(ent_type e, index_type comp, const Column* col, const void* value) {
+			_columns[comp] = col;
+			Location& loc = locate(e);
+			if (loc.archetype >= 0 && _archetypes[loc.archetype]->has(comp)) {
+				void* p = _archetypes[loc.archetype]->at(comp, loc.row);
+				col->destroy(p);
+				col->construct(p, value);
+				return;
+			}
+			migrate(e, loc, transition(loc.archetype, comp, true));
+			col->construct(_archetypes[loc.archetype]->at(comp, loc.row), value);
+		}
+		static void del(ent_type e, index_type comp) {
+			Location& loc = locate(e);
+			if (loc.archetype < 0 || !_archetypes[loc.archetype]->has(comp))
+				return;
+			_columns[comp]->destroy(_archetypes[loc.archetype]->at(comp, loc.row));
+			migrate(e, loc, transition(loc.archetype, comp, false));
+		}
+		// Drops every row; archetypes, their edges and chunks stay for reuse.
+		static void clear() {
+			for (index_type i = 0; i < _archetypes.size(); ++i)
+				_archetypes[i]->clear();
+			_locations.clear();
+		}
+		static void* get(ent_type e, index_type comp) {
+			const Location& loc = _locations[e.index()];
+			return _archetypes[loc.archetype]->at(comp, loc.row);
+		}
+
+		// Number of rows in archetypes containing every component of sig.
+		static size_type count(const Mask& sig) {
+			size_type n = 0;
+			for (index_type i = 0; i < _archetypes.size(); ++i)
+				if (_archetypes[i]->sig().test(sig))
+					n += _archetypes[i]->size();
+			return n;
+		}
+		// Walks all rows of archetypes containing sig, chunk by chunk.
+		template <class F>
+		static void each(const Mask& sig, F&& f) {
+			for (index_type i = 0; i < _archetypes.size(); ++i) {
+				Archetype& a = *_archetypes[i];
+				if (!a.sig().test(sig))
+					continue;
+				for (index_type k = 0; k*a.capacity() < a.size(); ++k) {
+					const ent_type* ents = a.entities(k);
+					for (index_type s = 0; s < a.capacity() && k*a.capacity()+s < a.size();) {
+						const ent_type e = ents[s];
+						f(e, Row{&a, k, s});
+						if (k*a.capacity()+s < a.size() && ents[s].id == e.id)
+							++s;
+					}
+				}
+			}
+		}
+
+	private:
+		struct Location
+		{
+			index_type	archetype;
+			index_type	row;
+		};
+
+		static Location& locate(ent_type e) {
+			while (_locations.size() <= e.index())
+				_locations.push({-1, -1});
+			return _locations[e.index()];
+		}
+		static index_type transition(index_type from, index_type comp, bool adding) {
+			index_type* edge = nullptr;
+			if (from >= 0) {
+				edge = &(adding ? _archetypes[from]->_addEdge : _archetypes[from]->_delEdge)[comp];
+				if (*edge != Archetype::Unknown)
+					return *edge;
+			}
+
+			Mask sig = from >= 0 ? _archetypes[from]->sig() : Mask{};
+			index_type comps[Params.MaxComponents];
+			size_type count = 0;
+			if (from >= 0)
+				for (index_type c = 0; c < Params.MaxComponents; ++c)
+					if (_archetypes[from]->has(c) && (adding || c != comp))
+						comps[count++] = c;
+			if (adding) {
+				sig.set(Mask::bit(comp));
+				comps[count++] = comp;
+				std::sort(comps, comps+count);
+			}
+			else sig.clear(Mask::bit(comp));
+
+			index_type to = -1;
+			if (count > 0) {
+				for (index_type i = 0; i < _archetypes.size() && to < 0; ++i)
+					if (_archetypes[i]->sig() == sig)
+						to = i;
+				if (to < 0) {
+					to = _archetypes.size();
+					_archetypes.push(new Archetype(sig, comps, count));
+				}
+			}
+			if (edge)
+				*edge = to;
+			return to;
+		}
+		static void migrate(ent_type e, Location& loc, index_type to) {
+			index_type row = -1;
+			if (to >= 0) {
+				Archetype& dst = *_archetypes[to];
+				row = dst.push(e);
+				if (loc.archetype >= 0) {
+					const Archetype& src = *_archetypes[loc.archetype];
+					for (index_type i = 0; i < dst._count; ++i) {
+						const index_type c = dst._comps[i];
+						if (src.has(c))
+							_columns[c]->relocate(dst.at(c, row), src.at(c, loc.row));
+					}
+				}
+			}
+			if (loc.archetype >= 0) {
+				const ent_type moved = _archetypes[loc.archetype]->erase(loc.row);
+				if (moved.id >= 0)
+					_locations[moved.index()].row = loc.row;
+			}
+			loc = {to, row};
+		}
+
+		static inline BAGEL_PER_WORLD const Column*	_columns[Params.MaxComponents] = {};
+		static inline BAGEL_PER_WORLD OwnerBag<Archetype,Params.InitialPackedSize>	_archetypes;
+		static inline BAGEL_PER_WORLD Bag<Location,Params.InitialEntities>		_locations;
+	};
+
+	template <class T>
+	class ChunkedStorage final : NoInstance
+	{
+	public:
+		static void add(ent_type e, const T& t) {
+			Archetypes::add(e, Component<T>::Index, Archetypes::column<T>(), &t);
+		}
+		static void add(Span<ent_type> ents, const T* ts) {
+			for (index_type i = 0; i < ents.size(); ++i)
+				add(ents[i], ts[i]);
+		}
+		static void reserve(size_type, id_type) {}
+		static void del(ent_type e) { Archetypes::del(e, Component<T>::Index); }
+		static void clear() { Archetypes::clear(); }
+		static T& get(ent_type e) {
+			return *static_cast<T*>(Archetypes::get(e, Component<T>::Index));
+		}
+		static T& get(const Archetypes::Row& r) {
+			return reinterpret_cast<T*>(r.archetype->column(Component<T>::Index, r.chunk))[r.slot];
+		}
+	};
+	template <class T>
+	struct is_chunked : std::false_type {};
+	template <class T>
+	struct is_chunked<ChunkedStorage<T>> : std::true_type {};
+	template <class T>
+	constexpr inline bool is_chunked_v = is_chunked<typename Storage<T>::type>::value;
+
+	/**
+	 * Secondary index from the value of field M to the entities holding it,
+	 * for fields declared with BAGEL_INDEX.
+	 *
+	 * Values live in an open-addressing hash table, each owning a list of
+	 * entities; removal swaps the list's last entity into the hole, so lists
+	 * are unordered. World updates the index when the component is added or
+	 * removed; after changing the field in place, call World::touch. Lists of
+	 * values no longer used stay allocated (empty).
+	 */
+	template <auto M>
+	class FieldIndex final : NoInstance
+	{
+		using key_type = member_t<M>;
+		using List = Bag<ent_type,Params.InitialPackedSize>;
+	public:
+		static Span<ent_type> find(const key_type& key) {
+			const index_type l = lookup(key, false);
+			if (l < 0)
+				return {nullptr, 0};
+			return {&(*_lists[l])[0], _lists[l]->size()};
+		}
+		static void insert(ent_type e, const key_type& key) {
+			const index_type l = lookup(key, true);
+			track(e);
+			if (_where[e.index()] == l)
+				return;
+			remove(e);
+			_where[e.index()] = l;
+			_pos[e.index()] = _lists[l]->size();
+			_lists[l]->push(e);
+		}
+		static void remove(ent_type e) {
+			if (e.index() >= _where.size() || _where[e.index()] < 0)
+				return;
+			List& list = *_lists[_where[e.index()]];
+			const ent_type last = list.pop();
+			if (last.index() != e.index()) {
+				list[_pos[e.index()]] = last;
+				_pos[last.index()] = _pos[e.index()];
+			}
+			_where[e.index()] = -1;
+		}
+
+		static void clear() {
+			for (index_type i = 0; i < _lists.size(); ++i)
+				_lists[i]->clear();
+			_where.clear();
+			_pos.clear();
+		}
+
+		static void save(Buffer& b) {
+			size_type lists = 0;
+			for (index_type i = 0; i < _table.capacity; ++i)
+				lists += _table.slots[i].list >= 0 && _lists[_table.slots[i].list]->size() > 0;
+			b.put(lists);
+			for (index_type i = 0; i < _table.capacity; ++i) {
+				const Slot& slot = _table.slots[i];
+				if (slot.list < 0 || _lists[slot.list]->size() == 0)
+					continue;
+				const List& list = *_lists[slot.list];
+				b.put(slot.key);
+				b.put(list.size());
+				b.put(&list[0], list.size());
+			}
+		}
+		static void load(Buffer::Reader& r) {
+			for (index_type i = 0; i < _lists.size(); ++i)
+				_lists[i]->clear();
+			for (index_type i = 0; i < _where.size(); ++i)
+				_where[i] = -1;
+			size_type lists;
+			r.get(lists);
+			for (index_type i = 0; i < lists; ++i) {
+				key_type key;
+				size_type n;
+				r.get(key);
+				r.get(n);
+				const index_type l = lookup(key, true);
+				List& list = *_lists[l];
+				list.resize(n);
+				r.get(&list[0], n);
+				for (index_type k = 0; k < n; ++k) {
+					track(list[k]);
+					_where[list[k].index()] = l;
+					_pos[list[k].index()] = k;
+				}
+			}
+		}
+	private:
+		struct Slot
+		{
+			key_type	key{};
+			index_type	list = -1;
+		};
+		struct Table : NoCopy
+		{
+			~Table() { delete[] slots; }
+
+			Slot*		slots = nullptr;
+			size_type	capacity = 0;	// power of 2
+			size_type	count = 0;
+		};
+
+		static void track(ent_type e) {
+			while (_where.size() <= e.index()) {
+				_where.push(-1);
+				_pos.push(-1);
+			}
+		}
+		static index_type lookup(const key_type& key, bool create) {
+			if (create && (_table.count+1)*2 > _table.capacity)
+				rehash(std::max(16, _table.capacity*2));
+			if (_table.capacity == 0)
+				return -1;
+			const size_type mask = _table.capacity-1;
+			size_type h = std::hash<key_type>{}(key) & mask;
+			while (_table.slots[h].list >= 0) {
+				if (_table.slots[h].key == key)
+					return _table.slots[h].list;
+				h = (h+1) & mask;
+			}
+			if (!create)
+				return -1;
+			_table.slots[h] = {key, _lists.size()};
+			_lists.push(new List);
+			++_table.count;
+			return _table.slots[h].list;
+		}
+		static void rehash(size_type capacity) {
+			Slot* old = _table.slots;
+			const size_type oldCapacity = _table.capacity;
+			_table.slots = new Slot[capacity];
+			_table.capacity = capacity;
+			for (index_type i = 0; i < oldCapacity; ++i) {
+				if (old[i].list < 0)
+					continue;
+				size_type h = std::hash<key_type>{}(old[i].key) & (capacity-1);
+				while (_table.slots[h].list >= 0)
+					h = (h+1) & (capacity-1);
+				_table.slots[h] = old[i];
+			}
+			delete[] old;
+		}
+
+		static inline BAGEL_PER_WORLD Table										_table;
+		static inline BAGEL_PER_WORLD OwnerBag<List,Params.InitialPackedSize>	_lists;
+		static inline BAGEL_PER_WORLD Bag<index_type,Params.InitialEntities>	_where;	// list, or -1
+		static inline BAGEL_PER_WORLD Bag<index_type,Params.InitialEntities>	_pos;	// in the list
+	};
+
+	/**
+	 * Registry of persistent queries (see View::cached).
+	 *
+	 * A query keeps a dense list of the entities having all of its included
+	 * and none of its excluded components. World updates the queries watching
+	 * a component whenever it is added or removed, and drops destroyed
+	 * entities; removal swaps the last entity into the hole.
+	 */
+	class Queries final : NoInstance
+	{
+	public:
+		class Query : NoCopy
+		{
+		public:
+			Query(const Mask& inc, const Mask& exc) : _inc(inc), _exc(exc) {}
+
+			bool matches(const Mask& m) const { return m.test(_inc) && !m.any(_exc); }
+			bool has(ent_type e) const {
+				return e.index() < _slots.size() && _slots[e.index()] >= 0;
+			}
+			size_type size() const { return _ents.size(); }
+			ent_type entity(index_type i) const { return _ents[i]; }
+
+			void insert(ent_type e) {
+				while (_slots.size() <= e.index())
+					_slots.push(-1);
+				_slots[e.index()] = _ents.size();
+				_ents.push(e);
+			}
+			void erase(ent_type e) {
+				const index_type slot = _slots[e.index()];
+				const ent_type last = _ents.pop();
+				if (last.index() != e.index()) {
+					_ents[slot] = last;
+					_slots[last.index()] = slot;
+				}
+				_slots[e.index()] = -1;
+			}
+			void clear() {
+				for (index_type i = 0; i < _ents.size(); ++i)
+					_slots[_ents[i].index()] = -1;
+				_ents.clear();
+			}
+		private:
+			friend class Queries;
+
+			Mask	_inc;
+			Mask	_exc;
+			Bag<ent_type,Params.InitialPackedSize>	_ents;
+			Bag<index_type,Params.InitialEntities>	_slots;
+		};
+
+		// Returns the query for (inc,exc); created tells whether it is new.
+		static index_type add(const Mask& inc, const Mask& exc,
+			const index_type* comps, size_type count, bool& created)
+		{
+			created = false;
+			for (index_type i = 0; i < _queries.size(); ++i)
+				if (_queries[i]->_inc == inc && _queries[i]->_exc == exc)
+					return i;
+			created = true;
+			const index_type q = _queries.size();
+			_queries.push(new Query(inc, exc));
+			for (index_type i = 0; i < count; ++i)
+				_watchers[comps[i]].push(q);
+			return q;
+		}
+		static Query& get(index_type q) { return *_queries[q]; }
+
+		// Called once e's mask m gained or lost comp.
+		static void update(ent_type e, const Mask& m, index_type comp) {
+			const auto& watchers = _watchers[comp];
+			for (index_type i = 0; i < watchers.size(); ++i) {
+				Query& q = *_queries[watchers[i]];
+				const bool match = q.matches(m);
+				if (match != q.has(e))
+					match ? q.insert(e) : q.erase(e);
+			}
+		}
+		static void remove(ent_type e) {
+			for (index_type i = 0; i < _queries.size(); ++i)
+				if (_queries[i]->has(e))
+					_queries[i]->erase(e);
+		}
+		static size_type size() { return _queries.size(); }
+		// Empties every query; the queries stay registered.
+		static void clear() {
+			for (index_type i = 0; i < size(); ++i)
+				_queries[i]->clear();
+		}
+
+		static void save(Buffer& b) {
+			b.put(size());
+			for (index_type i = 0; i < size(); ++i) {
+				const Query& q = *_queries[i];
+				b.put(q.size());
+				b.put(&q._ents[0], q.size());
+			}
+		}
+		// Restores the lists of the queries the snapshot knew; returns their count.
+		static size_type load(Buffer::Reader& r) {
+			size_type count;
+			r.get(count);
+			for (index_type i = 0; i < count; ++i) {
+				Query* q = i < size() ? _queries[i] : nullptr;
+				if (q)
+					q->clear();
+				size_type n;
+				r.get(n);
+				for (index_type k = 0; k < n; ++k) {
+					ent_type e;
+					r.get(e);
+					if (q)
+						q->insert(e);
+				}
+			}
+			return std::min(count, size());
+		}
+	private:
+		static inline BAGEL_PER_WORLD OwnerBag<Query,Params.InitialPackedSize>	_queries;
+		static inline BAGEL_PER_WORLD Bag<index_type,Params.InitialPackedSize>	_watchers[Params.MaxComponents];
+	};
+
+	template <class T>
+	using group_of_t = decltype(groupOf(TypeList<T>{}));
+
+	/**
+	 * Owning group over dense storages, declared with BAGEL_GROUP.
+	 *
+	 * The first size() entries of every owned storage belong to the entities
+	 * having all of Ts, in the same order. each() walks them in lockstep by
+	 * position, with no per-entity lookup. World swaps an entity into the
+	 * prefix when it gains the last of Ts, and out when it loses one; a
+	 * component can be owned by one group only.
+	 */
+	template <class ...Ts>
+	class Group final
+	{
+		using First = typename Storage<std::tuple_element_t<0, std::tuple<Ts...>>>::type;
+	public:
+		static_assert(((is_dense_v<Ts> && !is_chunked_v<Ts> && !std::is_empty_v<Ts>) && ...), "groups own packed or SoA storages");
+
+		static size_type size() { return _size; }
+
+		template <class F>
+		void each(F&& f) const {
+			for (index_type i = 0; i < _size; ++i)
+				f(First::entity(i), Storage<Ts>::type::get(i)...);
+		}
+		template <class F>
+		void parallelEach(F&& f, size_type grain = 64) const {
+			Jobs::run(_size, grain, [&](index_type begin, index_type end) {
+				for (index_type i = begin; i < end; ++i)
+					f(First::entity(i), Storage<Ts>::type::get(i)...);
+			});
+		}
+
+		// Called once e's mask m gained one of Ts.
+		static void enter(ent_type e, const Mask& m) {
+			if (!m.test(mask()) || First::indexOf(e) < _size)
+				return;
+			(Storage<Ts>::type::swap(Storage<Ts>::type::indexOf(e), _size), ...);
+			++_size;
+		}
+		// Called before e, with mask m, loses one of Ts.
+		static void leave(ent_type e, const Mask& m) {
+			if (!m.test(mask()) || First::indexOf(e) >= _size)
+				return;
+			--_size;
+			(Storage<Ts>::type::swap(Storage<Ts>::type::indexOf(e), _size), ...);
+		}
+		// Sets the prefix size after the owned storages were restored.
+		static void restore(size_type size) { _size = size; }
+	private:
+		static Mask mask() {
+			Mask m;
+			(m.set(Component<Ts>::Bit), ...);
+			return m;
+		}
+
+		static inline BAGEL_PER_WORLD size_type _size = 0;
+	};
+
+	/**
+	 * Change stamps of a component declared with BAGEL_TRACK: the World
+	 * tick at which each entity's T was last added or marked changed.
+	 * Indexed by entity; stale for entities without T.
+	 */
+	template <class T>
+	class Changes final : NoInstance
+	{
+	public:
+		static tick_type stamp(ent_type e) { return _stamps[e.index()]; }
+		static void mark(ent_type e, tick_type t) { _stamps[e.index()] = t; }
+		static void reserve(id_type ids) { _stamps.ensure(ids); }
+	private:
+		static inline BAGEL_PER_WORLD Bag<tick_type,Params.InitialEntities> _stamps;
+	};
+
+	template <class Inc, class Exc = TypeList<>, class Opt = TypeList<>, class Chg = TypeList<>>
+	class View;
+
 	class World final : NoInstance
 	{
 	public:
@@ -222,26 +2215,232 @@ namespace bagel
 			if (_ids.size() > 0)
 				return _ids.pop();
 			_masks.push(Mask{});
-			return {++_maxId.id};
+			_handles.push({++_maxId.id});
+			if (_maxId.id % BlockSize == 0) {
+				_blocks.push(Mask{});
+				_counts.push(BlockCount{});
+			}
+			return _maxId;
 		}
+		// Creates n entities into out, growing the entity tables at most once.
+		static void createEntities(size_type n, ent_type* out) {
+			index_type i = 0;
+			for (; i < n && _ids.size() > 0; ++i)
+				out[i] = _ids.pop();
+			reserveEntities(_maxId.id+1 + n-i);
+			for (; i < n; ++i)
+				out[i] = createEntity();
+		}
+		// Sizes the entity tables and the storages of Ts for n more entities.
+		template <class ...Ts>
+		static void reserve(size_type n) {
+			const id_type ids = _maxId.id+1 + n;
+			reserveEntities(ids);
+			(Storage<Ts>::type::reserve(n, ids), ...);
+		}
+		// Removes every registered component the entity has, then recycles it.
 		static void destroyEntity(ent_type ent) {
-			_masks[ent.id].clear();
-			_ids.push(ent);
+			if (!alive(ent))
+				return;
+			release(ent, Components{});
+			recycle(ent);
+		}
+		// Like destroyEntity for each of ents; reorders ents.
+		// Dense storages drop the batch from their highest index down, so
+		// entries near the end are popped rather than swapped in.
+		static void destroyEntities(Span<ent_type> ents) {
+			std::sort(ents.begin(), ents.end(), [](ent_type a, ent_type b) { return a.id < b.id; });
+			ent_type* last = std::unique(ents.begin(), ents.end(), [](ent_type a, ent_type b) { return a.id == b.id; });
+			last = std::remove_if(ents.begin(), last, [](ent_type e) { return !alive(e); });
+			const Span<ent_type> live(ents.data(), last - ents.begin());
+
+			release(live, Components{});
+			for (ent_type e : live)
+				recycle(e);
+		}
+		static bool alive(ent_type e) {
+			return e.id >= 0 && e.index() <= _maxId.id && _handles[e.index()].id == e.id;
 		}
 		static const Mask& mask(ent_type e) {
-			return _masks[e.id];
+			return _masks[e.index()];
 		}
 		static ent_type maxId() { return _maxId; }
+		static ent_type entity(id_type index) { return _handles[index]; }
+
+		/**
+		 * Writes the World into b: entity tables, storages, change stamps,
+		 * groups, cached queries, field indexes and resources (in sections
+		 * numbered from RegisteredCount), dense arrays in bulk.
+		 * restore() returns to exactly that state, iteration orders included.
+		 * Flush command buffers first. Hooks do not run, so state kept outside
+		 * the World (e.g. physics bodies) must be saved alongside it.
+		 * ChunkedStorage components are not supported.
+		 * Templates only so that such trees compile while not using them.
+		 *
+		 * The snapshot starts with a word naming its format (see format) and
+		 * is sealed with a checksum. restore() checks both before touching
+		 * the World, and returns false, leaving it as it was, for a buffer
+		 * that is truncated, damaged or written by a build with other
+		 * components, resources or parameters.
+		 */
+		template <class Cs = Components>
+		static void snapshot(Buffer& b) {
+			b.clear();
+			b.section(-1);
+			b.put(format(Cs{}, Resources<>::type{}));
+			b.put(_maxId);
+			b.put(_tick);
+			saveBag(b, _masks);
+			saveBag(b, _handles);
+			saveBag(b, _blocks);
+			saveBag(b, _counts);
+			saveBag(b, _ids);
+			Queries::save(b);
+			save(b, Cs{});
+			saveResources(b, Resources<>::type{});
+			b.seal();
+		}
+		template <class Cs = Components>
+		static bool restore(const Buffer& b) {
+			if (b.size() < static_cast<size_type>(2*sizeof(std::uint64_t)) || !b.sealed())
+				return false;
+			Buffer::Reader r(b);
+			std::uint64_t f;
+			r.get(f);
+			if (f != format(Cs{}, Resources<>::type{}))
+				return false;
+			r.get(_maxId);
+			r.get(_tick);
+			loadBag(r, _masks);
+			loadBag(r, _handles);
+			loadBag(r, _blocks);
+			loadBag(r, _counts);
+			loadBag(r, _ids);
+			// Queries cached after the snapshot are rebuilt from the masks.
+			for (index_type q = Queries::load(r); q < Queries::size(); ++q) {
+				Queries::Query& query = Queries::get(q);
+				query.clear();
+				scan(Mask{}, [&](ent_type e) {
+					if (query.matches(mask(e)))
+						query.insert(e);
+				});
+			}
+			load(r, Cs{});
+			loadResources(r, Resources<>::type{});
+			return true;
+		}
 
+		/**
+		 * Destroys every entity at once. Storages, entity tables, groups,
+		 * field indexes and cached queries drop to size zero but keep their
+		 * capacity, so the next entities reuse the memory and scans start
+		 * from an empty range again. Like restore(), hooks do not run: reset
+		 * state kept outside the World alongside. Ids restart from 0, so
+		 * handles from before the reset must be dropped. Flush command
+		 * buffers first.
+		 */
+		static void reset() {
+			_maxId = {-1};
+			_masks.clear();
+			_handles.clear();
+			_blocks.clear();
+			_counts.clear();
+			_ids.clear();
+			Queries::clear();
+			clear(Components{});
+			clearResources(Resources<>::type{});
+		}
+
+		/**
+		 * The World's single T, declared with BAGEL_RESOURCES: state with
+		 * no entity of its own, reached without a lookup. Starts as T{};
+		 * snapshot() saves it and reset() sets it back to T{}.
+		 */
 		template <class T>
-		static T& getComponent(ent_type e) {
+		static T& resource() {
+			static_assert(isResource<T>(Resources<>::type{}), "declare T with BAGEL_RESOURCES");
+			return _resource<T>;
+		}
+
+		// Registers a persistent query (see Queries), filled from the current world.
+		static index_type cache(const Mask& inc, const Mask& exc, const index_type* comps, size_type count) {
+			bool created;
+			const index_type id = Queries::add(inc, exc, comps, count, created);
+			Queries::Query& q = Queries::get(id);
+			if (created)
+				scan(inc, [&](ent_type e) {
+					if (q.matches(mask(e)))
+						q.insert(e);
+				});
+			return id;
+		}
+
+		/**
+		 * Calls f(e) for every entity whose mask contains inc, in id order.
+		 * Each block of BlockSize ids keeps the union of its masks; blocks
+		 * whose union lacks part of inc are skipped. Adds and removals keep
+		 * the union exact through per-block component counts (see count), so
+		 * scan only reads and is safe from concurrent read-only systems.
+		 */
+		template <class F>
+		static void scan(const Mask& inc, F&& f) {
+			for (index_type b = 0; b < _blocks.size(); ++b) {
+				if (!_blocks[b].test(inc))
+					continue;
+				const index_type first = b*BlockSize;
+				const index_type last = std::min(first+BlockSize, _maxId.id+1);
+				for (index_type i = first; i < last; ++i)
+					if (_masks[i].test(inc))
+						f(_handles[i]);
+			}
+		}
+
+		template <class T>
+		static decltype(auto) getComponent(ent_type e) {
 			return Storage<T>::type::get(e);
 		}
+		// getComponent for writing: stamps T as changed if it is tracked.
+		template <class T>
+		static decltype(auto) getMut(ent_type e) {
+			markChanged<T>(e);
+			return getComponent<T>(e);
+		}
+		// Stamps e's T with the current tick; safe from parallel callbacks
+		// as long as each marks its own entities.
+		template <class T>
+		static void markChanged(ent_type e) {
+			if constexpr (Tracked<T>::value)
+				Changes<T>::mark(e, _tick);
+		}
+		// Whether e's T was added or marked changed at tick since or later.
+		template <class T>
+		static bool changed(ent_type e, tick_type since = _tick) {
+			static_assert(Tracked<T>::value, "component not declared with BAGEL_TRACK");
+			return Changes<T>::stamp(e) >= since;
+		}
+		// Change ticks; Scheduler::run advances once per frame.
+		static tick_type tick() { return _tick; }
+		static void advance() { ++_tick; }
+		template <auto M>
+		static Span<member_t<M>> column() {
+			return Storage<class_of_t<M>>::type::template column<M>();
+		}
 
 		template <class T>
 		static void addComponent(ent_type e, const T& t) {
-			_masks[e.id].set(Component<T>::Bit);
+			_masks[e.index()].set(Component<T>::Bit);
+			count<T>(e);
 			Storage<T>::type::add(e,t);
+			if constexpr (grouped<T>)
+				group_of_t<T>::enter(e, _masks[e.index()]);
+			if constexpr (Tracked<T>::value) {
+				Changes<T>::reserve(e.index()+1);
+				Changes<T>::mark(e, _tick);
+			}
+			reindex(e, t, typename Indexes<T>::type{});
+			Queries::update(e, _masks[e.index()], Component<T>::Index);
+			if constexpr (OnAdd<T>::value)
+				OnAdd<T>::call(e, getComponent<T>(e));
 		}
 		template <class T, class...Ts>
 		static void addComponents(ent_type e, const T& t, const Ts&... ts) {
@@ -249,11 +2448,43 @@ namespace bagel
 			if constexpr (sizeof...(Ts)>0)
 				addComponents(e, ts...);
 		}
+		// Adds cols[i] to ents[i] for every i: each storage is sized once
+		// and dense columns are copied in bulk.
+		template <class ...Ts>
+		static void addComponents(Span<ent_type> ents, Span<const Ts>... cols) {
+			Mask m;
+			(m.set(Component<Ts>::Bit), ...);
+			id_type ids = 0;
+			for (ent_type e : ents) {
+				_masks[e.index()] |= m;
+				(count<Ts>(e), ...);
+				ids = std::max(ids, e.index()+1);
+			}
+			(Storage<Ts>::type::reserve(ents.size(), ids), ...);
+			(Storage<Ts>::type::add(ents, cols.data()), ...);
+			if constexpr ((grouped<Ts> || ...))
+				for (ent_type e : ents)
+					(enter<Ts>(e), ...);
+			(stamp<Ts>(ents, ids), ...);
+			(reindex(ents, cols), ...);
+			for (ent_type e : ents)
+				(Queries::update(e, _masks[e.index()], Component<Ts>::Index), ...);
+			if constexpr ((OnAdd<Ts>::value || ...))
+				for (ent_type e : ents)
+					(added<Ts>(e), ...);
+		}
 
 		template <class T>
 		static void delComponent(ent_type e) {
-			_masks[e.id].clear(Component<T>::Bit);
+			if constexpr (OnRemove<T>::value)
+				OnRemove<T>::call(e, getComponent<T>(e));
+			if constexpr (grouped<T>)
+				group_of_t<T>::leave(e, _masks[e.index()]);
+			_masks[e.index()].clear(Component<T>::Bit);
+			uncount<T>(e);
+			unindex(e, typename Indexes<T>::type{});
 			Storage<T>::type::del(e);
+			Queries::update(e, _masks[e.index()], Component<T>::Index);
 		}
 		template <class T, class ...Ts>
 		static void delComponents(ent_type e) {
@@ -262,10 +2493,462 @@ namespace bagel
 				delComponents<Ts...>(e);
 		}
 
+		// Entities whose T has field M equal to key, unordered (see FieldIndex).
+		template <class T, auto M>
+		static Span<ent_type> index(const member_t<M>& key) {
+			static_assert(listed<M>(typename Indexes<T>::type{}), "field not declared with BAGEL_INDEX");
+			return FieldIndex<M>::find(key);
+		}
+		// Re-reads the indexed fields of e's T after it was modified in place.
+		template <class T>
+		static void touch(ent_type e) {
+			if constexpr (!std::is_same_v<typename Indexes<T>::type, FieldList<>>) {
+				const T& t = getComponent<T>(e);
+				reindex(e, t, typename Indexes<T>::type{});
+			}
+		}
+
+		template <class T, class ...Ts>
+		static View<TypeList<T,Ts...>> view() { return {}; }
+		// The owning group declared as BAGEL_GROUP(Ts...).
+		template <class ...Ts>
+		static Group<Ts...> group() {
+			static_assert((std::is_same_v<group_of_t<Ts>, Group<Ts...>> && ...), "not declared with BAGEL_GROUP");
+			return {};
+		}
+		template <class T, class ...Ts, class F>
+		static void each(F&& f) { view<T,Ts...>().each(f); }
+		template <class T, class ...Ts, class F>
+		static void parallelEach(F&& f, size_type grain = 64) { view<T,Ts...>().parallelEach(f, grain); }
+
+	private:
+		template <auto M, auto ...Ms>
+		static constexpr bool listed(FieldList<Ms...>) {
+			return (std::is_same_v<FieldList<M>, FieldList<Ms>> || ...);
+		}
+		template <class T, auto ...Ms>
+		static void reindex([[maybe_unused]] ent_type e, [[maybe_unused]] const T& t, FieldList<Ms...>) {
+			(FieldIndex<Ms>::insert(e, t.*Ms), ...);
+		}
+		template <class T>
+		static void reindex(Span<ent_type> ents, Span<const T> ts) {
+			if constexpr (!std::is_same_v<typename Indexes<T>::type, FieldList<>>)
+				for (index_type i = 0; i < ents.size(); ++i)
+					reindex(ents[i], ts[i], typename Indexes<T>::type{});
+		}
+		template <auto ...Ms>
+		static void unindex([[maybe_unused]] ent_type e, FieldList<Ms...>) {
+			(FieldIndex<Ms>::remove(e), ...);
+		}
+
+		template <class ...Cs>
+		static void release(ent_type e, TypeList<Cs...>) {
+			const Mask& m = _masks[e.index()];
+			((m.test(Component<Cs>::Bit) ? release<Cs>(e) : void()), ...);
+		}
+		template <class T>
+		static void release(ent_type e) {
+			if constexpr (OnDestroy<T>::value)
+				OnDestroy<T>::call(e, getComponent<T>(e));
+			if constexpr (grouped<T>)
+				group_of_t<T>::leave(e, _masks[e.index()]);
+			uncount<T>(e);
+			unindex(e, typename Indexes<T>::type{});
+			Storage<T>::type::del(e);
+		}
+		template <class ...Cs>
+		static void release(Span<ent_type> ents, TypeList<Cs...>) {
+			(release<Cs>(ents), ...);
+		}
+		template <class T>
+		static void release(Span<ent_type> ents) {
+			using S = typename Storage<T>::type;
+			ent_type* last = std::partition(ents.begin(), ents.end(), [](ent_type e) {
+				return mask(e).test(Component<T>::Bit);
+			});
+			if constexpr (OnDestroy<T>::value)
+				for (ent_type* e = ents.begin(); e != last; ++e)
+					OnDestroy<T>::call(*e, getComponent<T>(*e));
+			if constexpr (grouped<T>)
+				for (ent_type* e = ents.begin(); e != last; ++e)
+					group_of_t<T>::leave(*e, _masks[e->index()]);
+			if constexpr (is_dense_v<T>)
+				std::sort(ents.begin(), last, [](ent_type a, ent_type b) {
+					return S::indexOf(a) > S::indexOf(b);
+				});
+			for (ent_type* e = ents.begin(); e != last; ++e) {
+				uncount<T>(*e);
+				unindex(*e, typename Indexes<T>::type{});
+				S::del(*e);
+			}
+		}
+		template <class T>
+		static constexpr bool grouped = !std::is_void_v<group_of_t<T>>;
+		template <class T>
+		static void enter(ent_type e) {
+			if constexpr (grouped<T>)
+				group_of_t<T>::enter(e, _masks[e.index()]);
+		}
+		// Names the layout snapshot() writes: the World's parameters, and the
+		// storage and size of every component and resource.
+		template <class ...Cs, class ...Rs>
+		static std::uint64_t format(TypeList<Cs...>, TypeList<Rs...>) {
+			std::uint64_t h = 0xcbf29ce484222325 ^ Params.IndexBits;
+			const auto mix = [&h](std::string_view name, std::size_t size) {
+				for (char c : name)
+					h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+				h = (h ^ size) * 0x100000001b3;
+			};
+			mix(typeName<Mask>(), sizeof(Mask));
+			(mix(typeName<typename Storage<Cs>::type>(), sizeof(Cs)), ...);
+			(mix(typeName<Rs>(), sizeof(Rs)), ...);
+			return h;
+		}
+		template <class B>
+		static void saveBag(Buffer& b, const B& bag) {
+			b.put(bag.size());
+			b.put(&bag[0], bag.size());
+		}
+		template <class B>
+		static void loadBag(Buffer::Reader& r, B& bag) {
+			size_type n;
+			r.get(n);
+			bag.resize(n);
+			r.get(&bag[0], n);
+		}
+		template <class T, class F>
+		static void holders(F&& f) {
+			for (index_type i = 0; i <= _maxId.id; ++i)
+				if (_masks[i].test(Component<T>::Bit))
+					f(_handles[i]);
+		}
+		template <class ...Cs>
+		static void save(Buffer& b, TypeList<Cs...>) { (save<Cs>(b), ...); }
+		template <class T>
+		static void save(Buffer& b) {
+			static_assert(!is_chunked_v<T>, "snapshots do not cover ChunkedStorage");
+			b.section(Component<T>::Index);
+			if constexpr (is_dense_v<T>)
+				Storage<T>::type::save(b);
+			else if constexpr (!std::is_empty_v<T>)
+				holders<T>([&](ent_type e) { b.put(getComponent<T>(e)); });
+			if constexpr (Tracked<T>::value)
+				holders<T>([&](ent_type e) { b.put(Changes<T>::stamp(e)); });
+			if constexpr (grouped<T>)
+				b.put(group_of_t<T>::size());
+			saveIndexes(b, typename Indexes<T>::type{});
+		}
+		template <auto ...Ms>
+		static void saveIndexes([[maybe_unused]] Buffer& b, FieldList<Ms...>) {
+			(FieldIndex<Ms>::save(b), ...);
+		}
+		template <class ...Cs>
+		static void load(Buffer::Reader& r, TypeList<Cs...>) { (load<Cs>(r), ...); }
+		template <class ...Cs>
+		static void clear(TypeList<Cs...>) { (clear<Cs>(), ...); }
+		template <class T>
+		static void clear() {
+			Storage<T>::type::clear();
+			if constexpr (grouped<T>)
+				group_of_t<T>::restore(0);
+			clearIndexes(typename Indexes<T>::type{});
+		}
+		template <auto ...Ms>
+		static void clearIndexes(FieldList<Ms...>) { (FieldIndex<Ms>::clear(), ...); }
+
+		template <class T, class ...Rs>
+		static constexpr bool isResource(TypeList<Rs...>) { return contains_v<T,Rs...>; }
+		template <class ...Rs>
+		static void saveResources([[maybe_unused]] Buffer& b, TypeList<Rs...>) {
+			[[maybe_unused]] index_type id = RegisteredCount;
+			((b.section(id++), b.put(_resource<Rs>)), ...);
+		}
+		template <class ...Rs>
+		static void loadResources([[maybe_unused]] Buffer::Reader& r, TypeList<Rs...>) { (r.get(_resource<Rs>), ...); }
+		template <class ...Rs>
+		static void clearResources(TypeList<Rs...>) { ((_resource<Rs> = Rs{}), ...); }
+		template <class T>
+		static void load(Buffer::Reader& r) {
+			const id_type ids = _maxId.id+1;
+			if constexpr (is_dense_v<T>)
+				Storage<T>::type::load(r, ids);
+			else if constexpr (!std::is_empty_v<T>) {
+				Storage<T>::type::reserve(0, ids);
+				holders<T>([&](ent_type e) { Storage<T>::type::load(r, e); });
+			}
+			if constexpr (Tracked<T>::value) {
+				Changes<T>::reserve(ids);
+				holders<T>([&](ent_type e) {
+					tick_type t;
+					r.get(t);
+					Changes<T>::mark(e, t);
+				});
+			}
+			if constexpr (grouped<T>) {
+				size_type n;
+				r.get(n);
+				group_of_t<T>::restore(n);
+			}
+			loadIndexes(r, typename Indexes<T>::type{});
+		}
+		template <auto ...Ms>
+		static void loadIndexes([[maybe_unused]] Buffer::Reader& r, FieldList<Ms...>) {
+			(FieldIndex<Ms>::load(r), ...);
+		}
+
+		template <class T>
+		static void added([[maybe_unused]] ent_type e) {
+			if constexpr (OnAdd<T>::value)
+				OnAdd<T>::call(e, getComponent<T>(e));
+		}
+		template <class T>
+		static void stamp([[maybe_unused]] Span<ent_type> ents, [[maybe_unused]] id_type ids) {
+			if constexpr (Tracked<T>::value) {
+				Changes<T>::reserve(ids);
+				for (ent_type e : ents)
+					Changes<T>::mark(e, _tick);
+			}
+		}
+
+		static void reserveEntities(id_type ids) {
+			_masks.ensure(ids);
+			_handles.ensure(ids);
+			_blocks.ensure(ids/BlockSize + 1);
+			_counts.ensure(ids/BlockSize + 1);
+		}
+		static void recycle(ent_type ent) {
+			Queries::remove(ent);
+			_masks[ent.index()].clear();
+			ent_type& h = _handles[ent.index()];
+			h.id = static_cast<id_type>((static_cast<unsigned>(h.id) + (1u<<Params.IndexBits))
+				& std::numeric_limits<id_type>::max());
+			_ids.push(h);
+		}
+		// Counts e's new T in its block, setting the block's bit for the first.
+		template <class T>
+		static void count(ent_type e) {
+			const index_type b = e.index()/BlockSize;
+			if (_counts[b].n[Component<T>::Index]++ == 0)
+				_blocks[b].set(Component<T>::Bit);
+		}
+		// Uncounts e's T, clearing the block's bit with the last.
+		template <class T>
+		static void uncount(ent_type e) {
+			const index_type b = e.index()/BlockSize;
+			if (--_counts[b].n[Component<T>::Index] == 0)
+				_blocks[b].clear(Component<T>::Bit);
+		}
+
+		static constexpr size_type BlockSize = 64;
+		// Entities of a block having each component.
+		struct BlockCount { std::uint8_t n[Params.MaxComponents]; };
+		static_assert(BlockSize <= std::numeric_limits<std::uint8_t>::max());
+
+		static inline BAGEL_PER_WORLD ent_type								_maxId{-1};
+		static inline BAGEL_PER_WORLD tick_type								_tick = 0;
+		static inline BAGEL_PER_WORLD Bag<Mask,		Params.InitialEntities> _masks;
+		static inline BAGEL_PER_WORLD Bag<ent_type,	Params.InitialEntities> _handles;
+		static inline BAGEL_PER_WORLD Bag<Mask,		Params.InitialEntities/BlockSize+1> _blocks;
+		static inline BAGEL_PER_WORLD Bag<BlockCount,	Params.InitialEntities/BlockSize+1> _counts;
+		static inline BAGEL_PER_WORLD Bag<ent_type,	Params.IdBagSize>		_ids;
+		template <class T>
+		static inline BAGEL_PER_WORLD T										_resource{};
+	};
+
+	/**
+	 * Records structural changes and plays them back in flush().
+	 *
+	 * Component values are copied into an arena of fixed-size blocks. The
+	 * blocks are kept between flushes. create() returns a placeholder handle,
+	 * valid in this buffer only, that flush() replaces with a new entity.
+	 *
+	 * flush() creates entities first. It then applies adds and removals
+	 * grouped by component and sorted by entity, keeping the recorded order
+	 * for each entity and component. Destroys go last, in one
+	 * World::destroyEntities batch. Commands on dead entities are dropped,
+	 * and so are removals of components the entity lacks. Adding T to an
+	 * entity that has it by then assigns the value in place and marks it
+	 * changed; shared values, which cannot be written, are removed and
+	 * added again, and tags are left as they are.
+	 *
+	 * local() is the calling thread's buffer, so systems running in parallel
+	 * record without locking. flushAll() plays back every thread's buffer,
+	 * in the order the buffers were created. Call it only when no buffer is
+	 * recording.
+	 */
+	class CommandBuffer final : NoCopy
+	{
+	public:
+		CommandBuffer() {
+			Registry& r = registry();
+			std::lock_guard<std::recursive_mutex> l(r.lock);
+			r.buffers.push(this);
+		}
+		~CommandBuffer() {
+			clear();
+			Registry& r = registry();
+			std::lock_guard<std::recursive_mutex> l(r.lock);
+			for (index_type i = 0; i < r.buffers.size(); ++i)
+				if (r.buffers[i] == this) {
+					for (; i+1 < r.buffers.size(); ++i)
+						r.buffers[i] = r.buffers[i+1];
+					r.buffers.pop();
+					break;
+				}
+		}
+
+		ent_type create() { return {-2 - _creates++}; }
+		void destroy(ent_type e) { _destroys.push(e); }
+
+		template <class T>
+		void add(ent_type e, const T& t) {
+			void* p = _arena.allocate(sizeof(T), alignof(T));
+			new (p) T(t);
+			_commands.push({&playAdd<T>, p, e, Component<T>::Index, _commands.size()});
+		}
+		template <class T>
+		void del(ent_type e) {
+			_commands.push({&playDel<T>, nullptr, e, Component<T>::Index, _commands.size()});
+		}
+
+		bool empty() const {
+			return _creates == 0 && _commands.size() == 0 && _destroys.size() == 0;
+		}
+
+		void flush() {
+			for (index_type i = 0; i < _creates; ++i)
+				_created.push(World::createEntity());
+			for (index_type i = 0; i < _commands.size(); ++i)
+				_commands[i].e = resolve(_commands[i].e);
+
+			if (_commands.size() > 0) {
+				Command* first = &_commands[0];
+				std::sort(first, first + _commands.size(), [](const Command& a, const Command& b) {
+					if (a.comp != b.comp) return a.comp < b.comp;
+					if (a.e.index() != b.e.index()) return a.e.index() < b.e.index();
+					return a.seq < b.seq;
+				});
+			}
+			for (index_type i = 0; i < _commands.size(); ++i)
+				_commands[i].play(_commands[i].e, _commands[i].value);
+			_commands.clear();
+
+			for (index_type i = 0; i < _destroys.size(); ++i)
+				_destroys[i] = resolve(_destroys[i]);
+			if (_destroys.size() > 0)
+				World::destroyEntities({&_destroys[0], _destroys.size()});
+			_destroys.clear();
+
+			_created.clear();
+			_creates = 0;
+			_arena.reset();
+		}
+
+		static CommandBuffer& local() {
+			static thread_local CommandBuffer buffer;
+			return buffer;
+		}
+		static void flushAll() {
+			Registry& r = registry();
+			std::lock_guard<std::recursive_mutex> l(r.lock);
+			for (index_type i = 0; i < r.buffers.size(); ++i)
+				if (!r.buffers[i]->empty())
+					r.buffers[i]->flush();
+		}
+
 	private:
-		static inline ent_type								_maxId{-1};
-		static inline Bag<Mask,		Params.InitialEntities> _masks;
-		static inline Bag<ent_type,	Params.IdBagSize>		_ids;
+		struct Command
+		{
+			void		(*play)(ent_type e, void* value);	// destroys value
+			void*		value;
+			ent_type	e;
+			index_type	comp;
+			index_type	seq;
+		};
+		struct Block
+		{
+			std::byte*	data;
+			size_type	size;
+		};
+		// Bump allocator over blocks that are reused after reset().
+		class Arena : NoCopy
+		{
+		public:
+			~Arena() {
+				for (index_type i = 0; i < _blocks.size(); ++i)
+					free(_blocks[i].data);
+			}
+			void* allocate(size_type size, size_type align) {
+				for (;; ++_block, _used = 0) {
+					if (_block == _blocks.size())
+						_blocks.push({static_cast<std::byte*>(malloc(std::max(BlockSize, size+align))),
+							std::max(BlockSize, size+align)});
+					const Block& b = _blocks[_block];
+					const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(b.data);
+					const size_type at = static_cast<size_type>(((base+_used+align-1) & ~std::uintptr_t(align-1)) - base);
+					if (at + size <= b.size) {
+						_used = at + size;
+						return b.data + at;
+					}
+				}
+			}
+			void reset() { _block = _used = 0; }
+		private:
+			static constexpr size_type BlockSize = 16*1024;
+
+			Bag<Block,Params.InitialPackedSize>	_blocks;
+			index_type							_block = 0;
+			size_type							_used = 0;
+		};
+		struct Registry
+		{
+			std::recursive_mutex							lock;	// flushing may create buffers
+			Bag<CommandBuffer*,Params.InitialPackedSize>	buffers;
+		};
+
+		template <class T>
+		static void playAdd(ent_type e, void* value) {
+			T* t = static_cast<T*>(value);
+			if (e.id >= 0 && World::alive(e)) {
+				if (!World::mask(e).test(Component<T>::Bit))
+					World::addComponent<T>(e, *t);
+				else if constexpr (std::is_empty_v<T>) {}
+				else if constexpr (std::is_assignable_v<decltype(World::getComponent<T>(e)), const T&>) {
+					World::getMut<T>(e) = *t;
+					World::touch<T>(e);
+				} else {
+					World::delComponent<T>(e);
+					World::addComponent<T>(e, *t);
+				}
+			}
+			t->~T();
+		}
+		template <class T>
+		static void playDel(ent_type e, void*) {
+			if (e.id >= 0 && World::alive(e) && World::mask(e).test(Component<T>::Bit))
+				World::delComponent<T>(e);
+		}
+
+		ent_type resolve(ent_type e) const {
+			return e.id <= -2 ? _created[-2 - e.id] : e;
+		}
+		// Drops recorded commands, destroying their values.
+		void clear() {
+			for (index_type i = 0; i < _commands.size(); ++i)
+				if (_commands[i].value)
+					_commands[i].play({-1}, _commands[i].value);
+			_commands.clear();
+		}
+		static Registry& registry() {
+			static BAGEL_PER_WORLD Registry r;
+			return r;
+		}
+
+		Arena											_arena;
+		Bag<Command,Params.InitialPackedSize>			_commands;
+		Bag<ent_type,Params.InitialPackedSize>			_destroys;
+		Bag<ent_type,Params.InitialPackedSize>			_created;
+		index_type										_creates = 0;
 	};
 
 	class Entity
@@ -279,7 +2962,7 @@ namespace bagel
 
 		const Mask& mask() const { return World::mask(_ent); }
 
-		template <class T> T& get() const { return World::getComponent<T>(_ent); }
+		template <class T> decltype(auto) get() const { return World::getComponent<T>(_ent); }
 		template <class T> void add(const T& t) const {
 			return World::addComponent<T>(_ent, t);
 		}
@@ -303,13 +2986,400 @@ namespace bagel
 	class MaskBuilder
 	{
 	public:
-		template <class T>
+		template <class ...Ts>
 		MaskBuilder& set() {
-			m.set(Component<T>::Bit);
+			(m.set(Component<Ts>::Bit), ...);
 			return *this;
 		}
 		Mask build() const { return m; }
 	private:
 		Mask m;
 	};
+
+	/**
+	 * Iterates entities having all of Ts, none of Es, and any of Os.
+	 *
+	 * The dense storage (see is_dense) with the fewest entries among Ts drives
+	 * the loop; the other requirements are checked with a single mask test.
+	 * If Ts has chunked components and their archetypes hold fewer rows, the
+	 * matching chunks are walked instead, reading chunked columns in place.
+	 * Without any dense storage in Ts, falls back to World::scan.
+	 *
+	 * The callback receives the entity, then a reference (or the storage's
+	 * proxy, see SoAStorage::Ref) for every non-empty T, then for every O a
+	 * pointer or null proxy if absent, or a bool for empty Os.
+	 * Dense drivers and cached lists are walked from their last entry down.
+	 * Removals swap a later entry into the hole, and so do the swaps of an
+	 * owning group, so removing the current entity's components, or
+	 * destroying it, from within the callback only moves entries already
+	 * visited. Other structural changes from the callback should be recorded
+	 * in a CommandBuffer.
+	 *
+	 * cached() returns the same view backed by a persistent query, walking its
+	 * entity list without testing masks.
+	 *
+	 * parallelEach() splits the driver (or cached list) into chunks of grain
+	 * entries run on Jobs. The callback may read any component and write the
+	 * ones it is given, but must not add or remove components or entities.
+	 *
+	 * changed<Cs...>(since) keeps the entities that have every C, each added
+	 * or marked changed at tick since or later; the loop itself is unchanged.
+	 */
+	template <class ...Ts, class ...Es, class ...Os, class ...Cs>
+	class View<TypeList<Ts...>, TypeList<Es...>, TypeList<Os...>, TypeList<Cs...>>
+	{
+	public:
+		View() = default;
+		explicit View(index_type query, tick_type since = 0) : _query(query), _since(since) {}
+
+		template <class ...Xs>
+		View<TypeList<Ts...>, TypeList<Es...,Xs...>, TypeList<Os...>, TypeList<Cs...>> without() const {
+			return View<TypeList<Ts...>, TypeList<Es...,Xs...>, TypeList<Os...>, TypeList<Cs...>>(-1, _since);
+		}
+		template <class ...Xs>
+		View<TypeList<Ts...>, TypeList<Es...>, TypeList<Os...,Xs...>, TypeList<Cs...>> optional() const {
+			return View<TypeList<Ts...>, TypeList<Es...>, TypeList<Os...,Xs...>, TypeList<Cs...>>(-1, _since);
+		}
+		// Only entities whose Xs were added or marked changed (see World::getMut)
+		// at tick since or later.
+		template <class ...Xs>
+		View<TypeList<Ts...>, TypeList<Es...>, TypeList<Os...>, TypeList<Cs...,Xs...>> changed(tick_type since = World::tick()) const {
+			static_assert((Tracked<Xs>::value && ...), "component not declared with BAGEL_TRACK");
+			return View<TypeList<Ts...>, TypeList<Es...>, TypeList<Os...>, TypeList<Cs...,Xs...>>(_query, since);
+		}
+
+		View cached() const {
+			static BAGEL_PER_WORLD const index_type query = [] {
+				const index_type comps[] = {Component<Ts>::Index..., Component<Es>::Index...};
+				return World::cache(MaskBuilder{}.set<Ts...>().build(), MaskBuilder{}.set<Es...>().build(),
+					comps, sizeof...(Ts)+sizeof...(Es));
+			}();
+			return View(query, _since);
+		}
+
+		template <class F>
+		void parallelEach(F&& f, size_type grain = 64) const {
+			if constexpr (sizeof...(Cs) > 0) {
+				auto g = fresh(f);
+				return unfiltered().parallelEach(g, grain);
+			}
+			if (_query >= 0) {
+				const Queries::Query& q = Queries::get(_query);
+				Jobs::run(q.size(), grain, [&](index_type begin, index_type end) {
+					for (index_type i = begin; i < end; ++i)
+						call(q.entity(i), f);
+				});
+				return;
+			}
+			static_assert((is_dense_v<Ts> || ...), "parallelEach needs a dense storage to split");
+			const Mask inc = MaskBuilder{}.set<Ts...>().build();
+			size_type best = -1;
+			(pick<Ts>(best), ...);
+			(split<Ts>(best, inc, f, grain) || ...);
+		}
+
+		template <class F>
+		void each(F&& f) const {
+			if constexpr (sizeof...(Cs) > 0) {
+				auto g = fresh(f);
+				return unfiltered().each(g);
+			}
+			if (_query >= 0) {
+				const Queries::Query& q = Queries::get(_query);
+				for (index_type i = q.size()-1; i >= 0; i = std::min(i, q.size())-1)
+					call(q.entity(i), f);
+				return;
+			}
+
+			const Mask inc = MaskBuilder{}.set<Ts...>().build();
+			size_type best = -1;
+			(pick<Ts>(best), ...);
+
+			if constexpr ((is_chunked_v<Ts> || ...)) {
+				Mask sig;
+				((is_chunked_v<Ts> ? sig.set(Component<Ts>::Bit) : void()), ...);
+				if (best < 0 || Archetypes::count(sig) <= best) {
+					Archetypes::each(sig, [&](ent_type e, const Archetypes::Row& r) {
+						visit(e, inc, f, &r);
+					});
+					return;
+				}
+			}
+			if (best < 0) {
+				World::scan(inc, [&](ent_type e) { visit(e, inc, f); });
+				return;
+			}
+			(drive<Ts>(best, inc, f) || ...);
+		}
+	private:
+		View<TypeList<Ts...>, TypeList<Es...>, TypeList<Os...>> unfiltered() const {
+			return View<TypeList<Ts...>, TypeList<Es...>, TypeList<Os...>>(_query);
+		}
+		// Wraps f to skip entities lacking a Cs or with a Cs unchanged since _since.
+		template <class F>
+		auto fresh(F& f) const {
+			return [&f, since = _since](ent_type e, auto&&... args) {
+				const Mask& m = World::mask(e);
+				if (((m.test(Component<Cs>::Bit) && Changes<Cs>::stamp(e) >= since) && ...))
+					f(e, std::forward<decltype(args)>(args)...);
+			};
+		}
+
+		template <class T>
+		static void pick(size_type& best) {
+			if constexpr (is_dense_v<T>) {
+				const size_type s = Storage<T>::type::size();
+				if (best < 0 || s < best)
+					best = s;
+			}
+		}
+		template <class D, class F>
+		static bool drive(size_type best, const Mask& inc, F& f) {
+			if constexpr (is_dense_v<D>) {
+				using S = typename Storage<D>::type;
+				if (S::size() != best)
+					return false;
+				for (index_type i = S::size()-1; i >= 0; i = std::min(i, S::size())-1)
+					visit(S::entity(i), inc, f);
+				return true;
+			}
+			else return false;
+		}
+		template <class D, class F>
+		static bool split(size_type best, const Mask& inc, F& f, size_type grain) {
+			if constexpr (is_dense_v<D>) {
+				using S = typename Storage<D>::type;
+				if (S::size() != best)
+					return false;
+				Jobs::run(S::size(), grain, [&](index_type begin, index_type end) {
+					for (index_type i = begin; i < end; ++i)
+						visit(S::entity(i), inc, f);
+				});
+				return true;
+			}
+			else return false;
+		}
+		template <class F>
+		static void visit(ent_type e, const Mask& inc, F& f, const Archetypes::Row* row = nullptr) {
+			const Mask& m = World::mask(e);
+			if (!m.test(inc) || (m.test(Component<Es>::Bit) || ...))
+				return;
+			call(e, f, row);
+		}
+		template <class F>
+		static void call(ent_type e, F& f, const Archetypes::Row* row = nullptr) {
+			std::apply(f, std::tuple_cat(std::make_tuple(e), fetch<Ts>(e, row)..., fetchOpt<Os>(e, World::mask(e))...));
+		}
+		template <class T>
+		static auto fetch(ent_type e, [[maybe_unused]] const Archetypes::Row* row) {
+			if constexpr (std::is_empty_v<T>) return std::tuple<>{};
+			else if constexpr (is_chunked_v<T>) {
+				if (row)
+					return std::tuple<T&>(ChunkedStorage<T>::get(*row));
+				return std::tuple<T&>(World::getComponent<T>(e));
+			}
+			else return std::tuple<decltype(World::getComponent<T>(e))>(World::getComponent<T>(e));
+		}
+		template <class T>
+		static auto fetchOpt(ent_type e, const Mask& m) {
+			const bool has = m.test(Component<T>::Bit);
+			if constexpr (std::is_empty_v<T>) return std::tuple<bool>(has);
+			else {
+				using R = decltype(World::getComponent<T>(e));
+				using P = std::remove_reference_t<R>*;
+				if constexpr (std::is_reference_v<R>) return std::tuple<P>(has ? &World::getComponent<T>(e) : nullptr);
+				else return std::tuple<R>(has ? World::getComponent<T>(e) : R{-1});
+			}
+		}
+
+		index_type	_query = -1;
+		tick_type	_since = 0;
+	};
+
+	template <auto ...Ms>
+	constexpr std::size_t fieldBytes(FieldList<Ms...>) { return (std::size_t{0} + ... + sizeof(member_t<Ms>)); }
+
+	// Fields of T as listed with BAGEL_FIELDS, else BAGEL_SERIALIZE, else void.
+	template <class T, class = void>
+	struct listed_fields { using type = typename Serialized<T>::type; };
+	template <class T>
+	struct listed_fields<T, std::void_t<typename Fields<T>::type>> { using type = typename Fields<T>::type; };
+
+	// Number of initializers an aggregate T takes (its fields, each element
+	// of an array field counting as one), found by brace-initializing it
+	// from values convertible to anything.
+	struct AnyField { template <class U> operator U() const; };
+	template <class T, class = void, class ...As>
+	struct aggregate_arity : std::integral_constant<int, int(sizeof...(As))-1> {};
+	template <class T, class ...As>
+	struct aggregate_arity<T, std::void_t<decltype(T{As{}...})>, As...> : aggregate_arity<T, void, As..., AnyField> {};
+	// Bytes of the fields of an aggregate, or 0: each field is initialized
+	// from a FieldSize, which adds the size of the type it converts to.
+	struct FieldSize
+	{
+		std::size_t*	bytes;
+
+		template <class U> operator U() const { *bytes += sizeof(U); return U{}; }
+	};
+	template <class T, std::size_t ...Is>
+	std::size_t aggregateBytes(std::index_sequence<Is...>) {
+		std::size_t bytes = 0;
+		[[maybe_unused]] const T t{(void(Is), FieldSize{&bytes})...};
+		return bytes;
+	}
+	template <class T>
+	std::size_t aggregateBytes() {
+		if constexpr (std::is_aggregate_v<T>)
+			return aggregateBytes<T>(std::make_index_sequence<std::max(aggregate_arity<T, void, AnyField>::value, 0)>{});
+		else return 0;
+	}
+
+	/**
+	 * What a storage costs per component, for Layout: Stored bytes held,
+	 * and the bytes and separate arrays a view reads to fetch one by entity
+	 * (Touched, Arrays), Whole if that reads all of T, padding included.
+	 * Shared values count as cached, being few.
+	 */
+	template <class S> struct StorageLayout;
+	template <class T> struct StorageLayout<SparseStorage<T>> {
+		static constexpr const char* Name = "sparse";
+		static constexpr bool Whole = true;
+		static constexpr std::size_t Stored = sizeof(T), Touched = sizeof(T), Arrays = 1;
+	};
+	template <class T> struct StorageLayout<PackedStorage<T>> {
+		static constexpr const char* Name = "packed";
+		static constexpr bool Whole = true;
+		static constexpr std::size_t Stored = sizeof(T) + sizeof(ent_type) + sizeof(index_type);
+		static constexpr std::size_t Touched = sizeof(index_type) + sizeof(T), Arrays = 2;
+	};
+	template <class T, auto ...Ms> struct StorageLayout<SoAStorage<T, FieldList<Ms...>>> {
+		static constexpr const char* Name = "SoA";
+		static constexpr bool Whole = false;
+		static constexpr std::size_t Cold = fieldBytes(typename Cold<T>::type{});
+		static constexpr std::size_t Hot = fieldBytes(FieldList<Ms...>{}) - Cold;
+		static constexpr std::size_t Stored = Hot + Cold + sizeof(ent_type) + sizeof(index_type);
+		static constexpr std::size_t Touched = sizeof(index_type) + Hot;
+		static constexpr std::size_t Arrays = 1 + (std::size_t{0} + ... + !is_listed<Ms, typename Cold<T>::type>::value);
+	};
+	template <class T> struct StorageLayout<TaggedStorage<T>> {
+		static constexpr const char* Name = "tagged";
+		static constexpr bool Whole = false;
+		static constexpr std::size_t Stored = 0, Touched = 0, Arrays = 0;
+	};
+	template <class T> struct StorageLayout<TagSetStorage<T>> {
+		static constexpr const char* Name = "tag set";
+		static constexpr bool Whole = false;
+		static constexpr std::size_t Stored = sizeof(ent_type) + sizeof(index_type), Touched = 0, Arrays = 0;
+	};
+	template <class T> struct StorageLayout<SharedStorage<T>> {
+		static constexpr const char* Name = "shared";
+		static constexpr bool Whole = false;
+		static constexpr std::size_t Stored = sizeof(typename SharedStorage<T>::handle_type), Touched = Stored, Arrays = 1;
+	};
+	template <class T> struct StorageLayout<SharedSetStorage<T>> {
+		static constexpr const char* Name = "shared set";
+		static constexpr bool Whole = false;
+		static constexpr std::size_t Touched = sizeof(typename SharedStorage<T>::handle_type), Arrays = 1;
+		static constexpr std::size_t Stored = Touched + sizeof(ent_type) + sizeof(index_type);
+	};
+	template <class T> struct StorageLayout<ChunkedStorage<T>> {
+		static constexpr const char* Name = "chunked";
+		static constexpr bool Whole = true;
+		static constexpr std::size_t Stored = sizeof(T), Touched = sizeof(T), Arrays = 1;
+	};
+
+	/**
+	 * Memory layout report.
+	 *
+	 * components() prints each registered component's storage, size,
+	 * alignment, padding (from the fields listed with BAGEL_FIELDS or
+	 * BAGEL_SERIALIZE, else those of an aggregate), BAGEL_COLD bytes, the
+	 * bytes its storage holds per component and the bytes a view reads to
+	 * fetch it.
+	 *
+	 * query() prints what a view or group reads per entity it visits: the
+	 * walked entity list, the mask (views only), each fetched component and
+	 * each change stamp, as bytes, padding among them, separate arrays, and
+	 * cache lines per 1000 entities when every array is walked in order.
+	 */
+	class Layout final : NoInstance
+	{
+	public:
+		static void components(std::FILE* out = stdout) {
+			std::fprintf(out, "%-28s %-10s %5s %5s %4s %4s %7s %7s\n",
+				"component", "storage", "size", "align", "pad", "cold", "stored", "touched");
+			components(out, Components{});
+		}
+		template <class ...Ts, class ...Es, class ...Os, class ...Cs>
+		static void query(const char* name, const View<TypeList<Ts...>, TypeList<Es...>, TypeList<Os...>, TypeList<Cs...>>&,
+			std::FILE* out = stdout)
+		{
+			Cost c{sizeof(ent_type) + sizeof(Mask), 0, 2};
+			(fetch<Ts>(c, false), ...);
+			(fetch<Os>(c, false), ...);
+			c.add(sizeof(tick_type)*sizeof...(Cs), sizeof...(Cs));
+			print(out, name, c);
+		}
+		template <class ...Ts>
+		static void query(const char* name, const Group<Ts...>&, std::FILE* out = stdout) {
+			Cost c{sizeof(ent_type), 0, 1};
+			(fetch<Ts>(c, true), ...);
+			print(out, name, c);
+		}
+	private:
+		struct Cost
+		{
+			std::size_t	bytes;
+			std::size_t	pad;
+			std::size_t	arrays;
+
+			void add(std::size_t b, std::size_t a) {
+				bytes += b;
+				arrays += a;
+			}
+		};
+
+		// sizeof(T) less its fields, or -1 if they are neither listed nor
+		// found in an aggregate.
+		template <class T>
+		static long padding() {
+			using F = typename listed_fields<T>::type;
+			if constexpr (std::is_empty_v<T>)
+				return 0;
+			else if constexpr (!std::is_void_v<F>)
+				return static_cast<long>(sizeof(T) - fieldBytes(F{}));
+			else if (const std::size_t bytes = aggregateBytes<T>())
+				return static_cast<long>(sizeof(T) - bytes);
+			else return -1;
+		}
+		template <class ...Cs>
+		static void components(std::FILE* out, TypeList<Cs...>) { (component<Cs>(out), ...); }
+		template <class T>
+		static void component(std::FILE* out) {
+			using L = StorageLayout<typename Storage<T>::type>;
+			const std::string_view name = typeName<T>();
+			const std::size_t size = std::is_empty_v<T> ? 0 : sizeof(T);
+			const std::size_t cold = fieldBytes(typename Cold<T>::type{});
+			char pad[8] = "?";
+			if (padding<T>() >= 0)
+				std::snprintf(pad, sizeof(pad), "%ld", padding<T>());
+			std::fprintf(out, "%-28.*s %-10s %5zu %5zu %4s %4zu %7zu %7zu\n",
+				static_cast<int>(name.size()), name.data(), L::Name, size, alignof(T), pad,
+				cold, L::Stored, L::Touched);
+		}
+		// Adds T fetched by entity, or by position when a group walks it.
+		template <class T>
+		static void fetch(Cost& c, bool byPosition) {
+			using L = StorageLayout<typename Storage<T>::type>;
+			if constexpr (!std::is_empty_v<T>) {
+				c.add(L::Touched - (byPosition ? sizeof(index_type) : 0), L::Arrays - byPosition);
+				if (L::Whole && padding<T>() > 0)
+					c.pad += padding<T>();
+			}
+		}
+		static void print(std::FILE* out, const char* name, const Cost& c) {
+			std::fprintf(out, "%-28s %4zu B/entity (%zu padding), %zu arrays, %zu lines per 1000 entities\n",
+				name, c.bytes, c.pad, c.arrays, (c.bytes*1000 + 63) / 64);
+		}
+	};
 }
@@ -5,38 +5,66 @@ constexpr bagel::Bagel Params{
 	.DynamicResize = true
 };
 
+// SoA (fields must be listed before the storage); cold fields go to side
+// tables that walks skip: a mole only reads its direction at the edges
+BAGEL_FIELDS(goldminer::Position, &goldminer::Position::x, &goldminer::Position::y)
+BAGEL_FIELDS(goldminer::Velocity, &goldminer::Velocity::dx, &goldminer::Velocity::dy)
+BAGEL_FIELDS(goldminer::Mole, &goldminer::Mole::speed, &goldminer::Mole::movingRight)
+BAGEL_COLD(goldminer::Mole, &goldminer::Mole::movingRight)
+BAGEL_STORAGE(goldminer::Position, bagel::SoAStorage)
+BAGEL_STORAGE(goldminer::Velocity, bagel::SoAStorage)
+BAGEL_STORAGE(goldminer::Mole, bagel::SoAStorage)
+
 // Packed
-BAGEL_STORAGE(goldminer::Position, bagel::PackedStorage)
-BAGEL_STORAGE(goldminer::Velocity, bagel::PackedStorage)
-BAGEL_STORAGE(goldminer::Renderable, bagel::PackedStorage)
 BAGEL_STORAGE(goldminer::PlayerInfo, bagel::PackedStorage)
-BAGEL_STORAGE(goldminer::Score, bagel::PackedStorage)
 BAGEL_STORAGE(goldminer::UIComponent, bagel::PackedStorage)
-BAGEL_STORAGE(goldminer::Value, bagel::PackedStorage)
-BAGEL_STORAGE(goldminer::Weight, bagel::PackedStorage)
-BAGEL_STORAGE(goldminer::Mole, bagel::PackedStorage)
 BAGEL_STORAGE(goldminer::LifeTime, bagel::PackedStorage)
-BAGEL_STORAGE(goldminer::DestroyTag, bagel::PackedStorage)
+BAGEL_STORAGE(goldminer::PhysicsBody, bagel::PackedStorage)
 
+// Shared (one copy per distinct value); sprites also group their entities
+BAGEL_STORAGE(goldminer::Renderable, bagel::SharedSetStorage)
+BAGEL_STORAGE(goldminer::ItemType, bagel::SharedStorage)
+BAGEL_STORAGE(goldminer::Value, bagel::SharedStorage)
+BAGEL_STORAGE(goldminer::Weight, bagel::SharedStorage)
 
 // Sparse
 BAGEL_STORAGE(goldminer::Rotation, bagel::SparseStorage)
 BAGEL_STORAGE(goldminer::Length, bagel::SparseStorage)
 BAGEL_STORAGE(goldminer::RopeControl, bagel::SparseStorage)
-BAGEL_STORAGE(goldminer::ItemType, bagel::SparseStorage)
-BAGEL_STORAGE(goldminer::GameTimer, bagel::SparseStorage)
 BAGEL_STORAGE(goldminer::PlayerInput, bagel::SparseStorage)
 BAGEL_STORAGE(goldminer::SoundEffect, bagel::SparseStorage)
 BAGEL_STORAGE(goldminer::Health, bagel::SparseStorage)
 BAGEL_STORAGE(goldminer::Name, bagel::SparseStorage)
-BAGEL_STORAGE(goldminer::PhysicsBody, bagel::SparseStorage)
 BAGEL_STORAGE(goldminer::GrabbedJoint, bagel::SparseStorage)
 
+// Secondary indexes (World::index)
+BAGEL_INDEX(goldminer::PlayerInfo, &goldminer::PlayerInfo::playerID)
+
+// Owning groups (World::group): the owned storages keep the group's
+// entities first, in the same order
+BAGEL_GROUP(goldminer::Position, goldminer::PhysicsBody)
+
+// Lifecycle hooks: release the Box2D objects owned by components
+BAGEL_ON_REMOVE(goldminer::PhysicsBody, goldminer::ReleasePhysicsBody)
+BAGEL_ON_REMOVE(goldminer::GrabbedJoint, goldminer::ReleaseGrabbedJoint)
+
+// Resources (World::resource)
+BAGEL_RESOURCES(goldminer::Match)
+
+// Change tracking (World::getMut, View::changed)
+BAGEL_TRACK(goldminer::Position)
+
+// Chunked (archetype tables): any of the above may be switched to
+// bagel::ChunkedStorage to A/B it against its current storage.
+
 // Tagged
-BAGEL_STORAGE(goldminer::Collectable, bagel::TaggedStorage)
-BAGEL_STORAGE(goldminer::RoperTag, bagel::TaggedStorage)
 BAGEL_STORAGE(goldminer::Collidable, bagel::TaggedStorage)
 BAGEL_STORAGE(goldminer::GameOverTag, bagel::TaggedStorage)
-BAGEL_STORAGE(goldminer::ScoredTag, bagel::TaggedStorage)
+
+// Tag sets (tags that are enumerated or drive views)
+BAGEL_STORAGE(goldminer::Collectable, bagel::TagSetStorage)
+BAGEL_STORAGE(goldminer::RoperTag, bagel::TagSetStorage)
+BAGEL_STORAGE(goldminer::ScoredTag, bagel::TagSetStorage)
+BAGEL_STORAGE(goldminer::DestroyTag, bagel::TagSetStorage)
 
 
@@ -0,0 +1,168 @@
+// Copyright (C) 2025 Moshe Sulamy
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+
+namespace bagel
+{
+	/**
+	 * Work-stealing thread pool, started on first use with one worker per
+	 * extra hardware thread.
+	 *
+	 * Every thread owns a deque of tasks: the owner pushes and pops at the
+	 * back, idle threads steal from the front of the others. A thread waiting
+	 * in run() keeps executing tasks, so nested runs cannot deadlock.
+	 *
+	 * With BAGEL_THREAD_WORLDS the World a task reads belongs to the thread
+	 * running it, so run() calls f on the calling thread and no pool starts;
+	 * parallelism comes from running one World per thread instead.
+	 */
+	class Jobs final
+	{
+	public:
+		Jobs() = delete;
+
+		// Calls f(begin,end) over [0,count) in chunks of grain, returning once all are done.
+		template <class F>
+		static void run(int count, int grain, F&& f) {
+#ifdef BAGEL_THREAD_WORLDS
+			(void)grain;
+			if (count > 0)
+				f(0, count);
+#else
+			Pool& p = pool();
+			if (count <= grain || p.workers.empty()) {
+				if (count > 0)
+					f(0, count);
+				return;
+			}
+
+			std::atomic<int> pending{(count + grain-1) / grain};
+			void* ctx = const_cast<void*>(static_cast<const void*>(&f));
+			p.queued.fetch_add(pending.load(std::memory_order_relaxed), std::memory_order_release);
+			{
+				Queue& q = p.queues[_self];
+				std::lock_guard<std::mutex> l(q.lock);
+				for (int b = 0; b < count; b += grain)
+					q.tasks.push_back({&invoke<F>, ctx, b, std::min(b+grain, count), &pending});
+			}
+			p.notify();
+
+			while (pending.load(std::memory_order_acquire) > 0) {
+				Task t;
+				if (p.take(_self, t))
+					t.run();
+				else std::this_thread::yield();
+			}
+#endif
+		}
+		static int threads() {
+#ifdef BAGEL_THREAD_WORLDS
+			return 1;
+#else
+			return static_cast<int>(pool().workers.size()) + 1;
+#endif
+		}
+
+	private:
+		struct Task
+		{
+			void				(*fn)(void* ctx, int begin, int end);
+			void*				ctx;
+			int					begin, end;
+			std::atomic<int>*	pending;
+
+			void run() const {
+				fn(ctx, begin, end);
+				pending->fetch_sub(1, std::memory_order_release);
+			}
+		};
+		struct Queue
+		{
+			std::mutex			lock;
+			std::deque<Task>	tasks;
+		};
+
+		class Pool
+		{
+		public:
+			Pool() : queues(std::max(1u, std::thread::hardware_concurrency())) {
+				for (int i = 1; i < static_cast<int>(queues.size()); ++i)
+					workers.emplace_back([this, i] { work(i); });
+			}
+			~Pool() {
+				stop = true;
+				notify();
+				for (std::thread& w : workers)
+					w.join();
+			}
+
+			// Pops own newest task, or steals another thread's oldest.
+			bool take(int self, Task& t) {
+				if (queued.load(std::memory_order_acquire) == 0)
+					return false;
+				const int n = static_cast<int>(queues.size());
+				for (int k = 0; k < n; ++k) {
+					Queue& q = queues[(self+k) % n];
+					std::lock_guard<std::mutex> l(q.lock);
+					if (q.tasks.empty())
+						continue;
+					if (k == 0) {
+						t = q.tasks.back();
+						q.tasks.pop_back();
+					}
+					else {
+						t = q.tasks.front();
+						q.tasks.pop_front();
+					}
+					queued.fetch_sub(1, std::memory_order_relaxed);
+					return true;
+				}
+				return false;
+			}
+			void notify() {
+				{ std::lock_guard<std::mutex> l(sleep); }
+				wake.notify_all();
+			}
+
+			std::vector<Queue>			queues;
+			std::vector<std::thread>	workers;
+			std::atomic<int>			queued{0};
+		private:
+			void work(int self) {
+				_self = self;
+				while (!stop) {
+					Task t;
+					if (take(self, t)) {
+						t.run();
+						continue;
+					}
+					std::unique_lock<std::mutex> l(sleep);
+					wake.wait(l, [this] { return stop || queued.load() > 0; });
+				}
+			}
+
+			std::atomic<bool>			stop{false};
+			std::mutex					sleep;
+			std::condition_variable		wake;
+		};
+
+		template <class F>
+		static void invoke(void* ctx, int begin, int end) {
+			(*static_cast<std::remove_reference_t<F>*>(ctx))(begin, end);
+		}
+		static Pool& pool() {
+			static Pool p;
+			return p;
+		}
+
+		static inline thread_local int _self = 0;
+	};
+}
@@ -0,0 +1,201 @@
+// Copyright (C) 2025 Moshe Sulamy
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <vector>
+#include "bagel.h"
+
+namespace bagel
+{
+	template <class ...Ts> struct Reads {};
+	template <class ...Ts> struct Writes {};
+
+	// Access signature of a system, e.g. System<Reads<Position>,Writes<Rotation>>.
+	template <class R, class W> struct System;
+	template <class ...Rs, class ...Ws>
+	struct System<Reads<Rs...>,Writes<Ws...>> {};
+
+	// Written by systems that must run on the thread calling Scheduler::run.
+	struct MainThread {};
+	// Written by systems that change components or entities directly rather
+	// than through CommandBuffer::local(); read by all.
+	struct Structure {};
+
+	/**
+	 * Runs a frame's systems according to their declared access sets.
+	 *
+	 * Reads and writes name components or any other type standing for shared
+	 * state. Two systems conflict when one writes what the other reads or
+	 * writes; conflicting systems keep their registration order, the rest
+	 * may run concurrently on the Jobs pool. The dependency DAG is built on
+	 * the first run, which also runs serially so that lazily created state
+	 * (cached queries, function statics) is initialized on one thread.
+	 *
+	 * Each system is placed in the stage after its latest conflicting
+	 * predecessor; stages run one after another. Command buffers are flushed
+	 * after every stage (after every system on the serial first run), so a
+	 * system deferring a change must declare the components it changes as
+	 * written.
+	 *
+	 * Every run starts a new World tick, so View::changed() defaults to the
+	 * changes made during the current frame.
+	 */
+	class Scheduler final
+	{
+	public:
+		Scheduler() = default;
+		Scheduler(const Scheduler&) = delete;
+		void operator=(const Scheduler&) = delete;
+
+		template <class S, class F>
+		Scheduler& add(const char* name, F&& f) {
+			Node n;
+			n.name = name;
+			n.fn = std::forward<F>(f);
+			access(n, S{});
+			_nodes.push_back(std::move(n));
+			_stages.clear();
+			return *this;
+		}
+
+		void run() {
+			World::advance();
+			if (_stages.empty()) {
+				build();
+				for (Node& n : _nodes) {
+					n.run();
+					CommandBuffer::flushAll();
+				}
+				return;
+			}
+			for (const Stage& s : _stages) {
+				Jobs::run(static_cast<int>(s.pool.size()), 1, [&](int begin, int end) {
+					for (int i = begin; i < end; ++i)
+						_nodes[s.pool[i]].run();
+				});
+				for (int i : s.main)
+					_nodes[i].run();
+				CommandBuffer::flushAll();
+			}
+		}
+
+		// Prints the stages and the critical path, weighted by average run time.
+		void print(std::ostream& os) {
+			if (_stages.empty())
+				build();
+			double total = 0;
+			for (const Node& n : _nodes)
+				total += n.average();
+
+			os << "Schedule: " << _nodes.size() << " systems in " << _stages.size()
+				<< " stages, " << Jobs::threads() << " threads\n";
+			for (size_t s = 0; s < _stages.size(); ++s) {
+				os << "  stage " << s << ":";
+				for (int i : _stages[s].pool)
+					os << ' ' << _nodes[i].name;
+				for (int i : _stages[s].main)
+					os << ' ' << _nodes[i].name << "[main]";
+				os << '\n';
+			}
+
+			std::vector<double> cost(_nodes.size());
+			std::vector<int> prev(_nodes.size(), -1);
+			int last = 0;
+			for (size_t i = 0; i < _nodes.size(); ++i) {
+				for (int p : _nodes[i].after)
+					if (cost[p] > cost[i]) {
+						cost[i] = cost[p];
+						prev[i] = p;
+					}
+				cost[i] += _nodes[i].runs ? _nodes[i].average() : 1;
+				if (cost[i] > cost[last])
+					last = static_cast<int>(i);
+			}
+			std::vector<int> path;
+			for (int i = last; i >= 0; i = prev[i])
+				path.push_back(i);
+
+			os << "Critical path";
+			if (total > 0)
+				os << " (" << cost[last]*1000 << " of " << total*1000 << " ms per frame)";
+			os << ':';
+			for (auto i = path.rbegin(); i != path.rend(); ++i)
+				os << (i == path.rbegin() ? " " : " -> ") << _nodes[*i].name;
+			os << '\n';
+		}
+
+	private:
+		struct Node
+		{
+			const char*				name = nullptr;
+			std::function<void()>	fn;
+			std::vector<int>		reads, writes;	// sorted keys
+			std::vector<int>		after;			// conflicting earlier systems
+			bool					main = false;
+			double					seconds = 0;
+			int						runs = 0;
+
+			void run() {
+				const auto start = std::chrono::steady_clock::now();
+				fn();
+				seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				++runs;
+			}
+			double average() const { return runs ? seconds / runs : 0; }
+		};
+		struct Stage
+		{
+			std::vector<int>	pool, main;
+		};
+
+		template <class ...Rs, class ...Ws>
+		static void access(Node& n, System<Reads<Rs...>,Writes<Ws...>>) {
+			n.reads = {key<Structure>(), key<Rs>()...};
+			n.writes = {key<Ws>()...};
+			n.main = ((key<Ws>() == key<MainThread>()) || ...);
+			std::sort(n.reads.begin(), n.reads.end());
+			std::sort(n.writes.begin(), n.writes.end());
+		}
+		static bool overlap(const std::vector<int>& a, const std::vector<int>& b) {
+			for (auto i = a.begin(), j = b.begin(); i != a.end() && j != b.end();) {
+				if (*i == *j)
+					return true;
+				*i < *j ? ++i : ++j;
+			}
+			return false;
+		}
+		static bool conflict(const Node& a, const Node& b) {
+			return overlap(a.writes, b.reads) || overlap(a.writes, b.writes) || overlap(b.writes, a.reads);
+		}
+
+		void build() {
+			std::vector<int> stage(_nodes.size(), 0);
+			for (size_t i = 0; i < _nodes.size(); ++i) {
+				_nodes[i].after.clear();
+				for (size_t j = 0; j < i; ++j)
+					if (conflict(_nodes[j], _nodes[i])) {
+						_nodes[i].after.push_back(static_cast<int>(j));
+						stage[i] = std::max(stage[i], stage[j]+1);
+					}
+				if (stage[i] >= static_cast<int>(_stages.size()))
+					_stages.resize(stage[i]+1);
+				Stage& s = _stages[stage[i]];
+				(_nodes[i].main ? s.main : s.pool).push_back(static_cast<int>(i));
+			}
+		}
+
+		template <class T>
+		static int key() {
+			static const int k = _keys++;
+			return k;
+		}
+
+		std::vector<Node>	_nodes;
+		std::vector<Stage>	_stages;
+		static inline std::atomic<int>	_keys{0};
+	};
+}
@@ -0,0 +1,103 @@
+// Copyright (C) 2025 Moshe Sulamy
+
+// Measures DynamicBag growth under each allocation policy: the time to fill
+// fresh bags from their initial capacity, and how many elements growth moved.
+// "realloc (old)" is the growth DynamicBag used before, valid for trivially
+// copyable elements only.
+// Build with -DBAGEL_BENCHMARKS=ON.
+
+#include "gold_miner_ecs.h"
+#include "bagel.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using namespace bagel;
+using Clock = std::chrono::steady_clock;
+
+template <class F>
+static double millis(F&& f) {
+	double best = 1e30;
+	for (int run = 0; run < 5; ++run) {
+		const auto start = Clock::now();
+		f();
+		best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+	}
+	return best;
+}
+
+// A string component that counts how often it is moved.
+struct Label
+{
+	static inline long moves = 0;
+
+	std::string	text;
+
+	Label() = default;
+	explicit Label(int i) : text("entity-" + std::to_string(i)) {}
+	Label(Label&& l) noexcept : text(std::move(l.text)) { ++moves; }
+	Label& operator=(Label&& l) noexcept { text = std::move(l.text); return *this; }
+};
+
+struct Wide
+{
+	float v[16];
+};
+
+// The realloc-based growth DynamicBag had before.
+template <class T, int N>
+class ReallocBag : NoCopy
+{
+public:
+	void push(const T& t) {
+		if (_size == _capacity) {
+			_capacity *= 2;
+			_arr = static_cast<T*>(realloc(_arr, sizeof(T)*_capacity));
+		}
+		_arr[_size++] = t;
+	}
+	~ReallocBag() { free(_arr); }
+private:
+	T*			_arr = static_cast<T*>(malloc(sizeof(T)*N));
+	size_type	_size = 0;
+	size_type	_capacity = N;
+};
+
+template <class Bag, class T>
+static double fill(int bags, int count) {
+	return millis([&] {
+		for (int b = 0; b < bags; ++b) {
+			Bag bag;
+			for (int i = 0; i < count; ++i)
+				bag.push(T{});
+		}
+	});
+}
+
+template <class Alloc>
+static void bench(const char* name, int bags, int count) {
+	const double ints = fill<DynamicBag<int,5,alignof(int),Alloc>, int>(bags, count);
+	const double wide = fill<DynamicBag<Wide,5,alignof(Wide),Alloc>, Wide>(bags, count);
+	Label::moves = 0;
+	const double labels = millis([&] {
+		for (int b = 0; b < bags; ++b) {
+			DynamicBag<Label,5,alignof(Label),Alloc> bag;
+			for (int i = 0; i < count; ++i)
+				bag.emplace(i);
+		}
+	});
+	printf("%-14s int %7.2fms  64B %7.2fms  string %7.2fms (%ld moves per bag)\n",
+		name, ints, wide, labels, Label::moves / (5*bags));
+}
+
+int main() {
+	constexpr int Bags = 20, Count = 1 << 20;
+	printf("%d bags x %d elements, growing from 5\n", Bags, Count);
+	printf("%-14s int %7.2fms  64B %7.2fms\n", "realloc (old)",
+		fill<ReallocBag<int,5>, int>(Bags, Count), fill<ReallocBag<Wide,5>, Wide>(Bags, Count));
+	bench<MallocAlloc>("malloc", Bags, Count);
+	bench<HugePageAlloc>("huge pages", Bags, Count);
+	bench<VirtualAlloc>("virtual", Bags, Count);
+	return 0;
+}
@@ -0,0 +1,21 @@
+// Copyright (C) 2025 Moshe Sulamy
+
+// Prints the layout of every registered component (bagel::Layout) and the
+// bytes read per entity by the game's per-frame queries.
+// Build with -DBAGEL_BENCHMARKS=ON.
+
+#include "gold_miner_ecs.h"
+#include "bagel.h"
+#include <cstdio>
+
+using namespace bagel;
+using namespace goldminer;
+
+int main() {
+	Layout::components();
+	printf("\n");
+	Layout::query("RenderSystem", World::view<Renderable, Position>());
+	Layout::query("PhysicsSyncSystem", World::group<Position, PhysicsBody>());
+	Layout::query("MoleSystem", World::view<Mole, Position, Velocity>());
+	return 0;
+}
@@ -0,0 +1,115 @@
+// Copyright (C) 2025 Moshe Sulamy
+
+// Compares the SIMD MultiMask kernels with the plain word-by-word loop they
+// replaced, and World::scan's block summaries with a per-entity mask scan.
+// Build with -DBAGEL_BENCHMARKS=ON (add -DBAGEL_AVX2=ON for the AVX2 path).
+
+#include "gold_miner_ecs.h"
+#include "bagel.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace bagel;
+using Clock = std::chrono::steady_clock;
+
+// Best of several runs, to keep cache warm-up out of the comparison.
+template <class F>
+static double millis(F&& f) {
+	double best = 1e30;
+	for (int run = 0; run < 5; ++run) {
+		const auto start = Clock::now();
+		f();
+		best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+	}
+	return best;
+}
+
+// The loop MultiMask::test used before the SIMD kernels.
+template <int N>
+static bool scalarTest(const MultiMask<N>& a, const MultiMask<N>& b) {
+	constexpr int Size = (N-1)/64 + 1;
+	const auto* x = reinterpret_cast<const std::uint64_t*>(&a);
+	const auto* y = reinterpret_cast<const std::uint64_t*>(&b);
+	for (int i = 0; i < Size; ++i)
+		if ((x[i] & y[i]) != y[i])
+			return false;
+	return true;
+}
+
+template <int N>
+static void benchMasks(int count) {
+	std::mt19937 rng(N);
+	std::vector<MultiMask<N>> masks(count);
+	for (auto& m : masks)
+		for (int k = 0; k < N/4; ++k)
+			m.set(MultiMask<N>::bit(rng() % N));
+	MultiMask<N> query;
+	query.set(MultiMask<N>::bit(N-1));
+
+	int hitsSimd = 0, hitsScalar = 0;
+	const double simd = millis([&] {
+		hitsSimd = 0;
+		for (const auto& m : masks)
+			hitsSimd += m.test(query);
+	});
+	const double scalar = millis([&] {
+		hitsScalar = 0;
+		for (const auto& m : masks)
+			hitsScalar += scalarTest(m, query);
+	});
+	printf("MultiMask<%d> x%d: simd %.2fms, scalar %.2fms (%d/%d hits)\n",
+		N, count, simd, scalar, hitsSimd, hitsScalar);
+}
+
+static void benchSingleMask(int count) {
+	std::mt19937 rng(1);
+	std::vector<SingleMask> masks(count);
+	for (auto& m : masks)
+		m.set(SingleMask::bit(rng() % BitsetWidth));
+	SingleMask query;
+	query.set(SingleMask::bit(5));
+
+	int hits = 0;
+	const double t = millis([&] {
+		hits = 0;
+		for (const auto& m : masks)
+			hits += m.test(query);
+	});
+	printf("SingleMask x%d: %.2fms (%d hits)\n", count, t, hits);
+}
+
+// Entities with Health come in runs of 64 every 6400 ids (1% of the world).
+static void benchScan(int count) {
+	while (World::maxId().id+1 < count) {
+		const ent_type e = World::createEntity();
+		if (e.index() % 6400 < 64)
+			World::addComponent(e, goldminer::Health{});
+	}
+	const Mask inc = MaskBuilder{}.set<goldminer::Health>().build();
+
+	int hitsScan = 0, hitsFlat = 0;
+	const double scan = millis([&] {
+		hitsScan = 0;
+		World::scan(inc, [&](ent_type) { ++hitsScan; });
+	});
+	const double flat = millis([&] {
+		hitsFlat = 0;
+		for (id_type id = 0; id <= World::maxId().id; ++id)
+			hitsFlat += World::mask(World::entity(id)).test(inc);
+	});
+	printf("World x%d: scan %.2fms, flat %.2fms (%d/%d hits)\n",
+		count, scan, flat, hitsScan, hitsFlat);
+}
+
+int main() {
+	for (int count : {100000, 1000000}) {
+		benchSingleMask(count);
+		benchMasks<128>(count);
+		benchMasks<256>(count);
+		benchMasks<512>(count);
+		benchScan(count);
+	}
+}
@@ -0,0 +1,53 @@
+// Copyright (C) 2025 Moshe Sulamy
+
+// Heap held by the World when n entities are alive: items of five kinds
+// (Position, Renderable, ItemType, Value, Weight), plus two ropes created
+// last, so with the highest ids, carrying the sparse rope components.
+// Each size runs in a fresh process.
+// Build with -DBAGEL_BENCHMARKS=ON.
+
+#include "gold_miner_ecs.h"
+#include "bagel.h"
+#include <cstdio>
+#include <malloc.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace bagel;
+using namespace goldminer;
+
+// Bytes in use, including the blocks malloc served with mmap.
+static std::size_t heap() {
+	const struct mallinfo2 m = mallinfo2();
+	return m.uordblks + m.hblkhd;
+}
+
+static void populate(int n) {
+	for (int i = 0; i < n-2; ++i) {
+		Entity e = Entity::create();
+		const int kind = i % 5;
+		e.addAll(Position{float(i), 0}, Renderable{SPRITE_GOLD + kind}, ItemType{ItemType::Type(kind)},
+			Value{50 * (kind+1)}, Weight{1.0f + kind % 3});
+	}
+	for (int p = 1; p <= 2; ++p) {
+		Entity rope = Entity::create();
+		rope.addAll(Position{}, Rotation{}, Length{}, RopeControl{}, PlayerInput{},
+			SoundEffect{}, PlayerInfo{p}, RoperTag{});
+	}
+}
+
+int main() {
+	for (int n : {10000, 100000, 1000000}) {
+		fflush(stdout);
+		if (fork() == 0) {
+			const std::size_t before = heap();
+			populate(n);
+			const double mb = double(heap() - before) / (1 << 20);
+			printf("%8d entities: %8.2f MB\n", n, mb);
+			fflush(stdout);
+			_exit(0);
+		}
+		wait(nullptr);
+	}
+	return 0;
+}
@@ -0,0 +1,107 @@
+// Copyright (C) 2025 Moshe Sulamy
+
+// Snapshots and restores a World of collectable items and moles, reporting
+// the time each takes, and checks the round trip: restoring a snapshot and
+// taking another gives the same bytes, while truncated, damaged or foreign
+// buffers are refused and leave the World as it was. Exits with 1 if any
+// check fails.
+// Build with -DBAGEL_BENCHMARKS=ON.
+
+#include "gold_miner_ecs.h"
+#include "bagel.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace bagel;
+using namespace goldminer;
+using Clock = std::chrono::steady_clock;
+
+constexpr int Items = 20000, Moles = 2000, Runs = 50;
+
+static int failures = 0;
+
+static void check(const char* what, bool ok) {
+	printf("%-44s %s\n", what, ok ? "ok" : "FAILED");
+	failures += !ok;
+}
+
+static void populate() {
+	std::vector<ent_type> ents(Items);
+	World::createEntities(Items, ents.data());
+	for (int i = 0; i < Items; ++i) {
+		Entity e{ents[i]};
+		e.addAll(Position{float(i % 1280), float(i / 1280)}, Renderable{SPRITE_GOLD + i % 5},
+			ItemType{ItemType::Type(i % 5)}, Value{50 * (i % 5 + 1)}, Weight{1.0f + i % 3}, Collectable{});
+		if (i % 7 == 0)
+			e.add(Name{Strings::intern(i % 2 ? "nugget" : "rock")});
+	}
+	for (int i = 0; i < Moles; ++i) {
+		Entity e = Entity::create();
+		e.addAll(Position{float(i), 600.0f}, Velocity{1.0f + i % 7, 0.0f}, Mole{}, LifeTime{float(i % 3)});
+	}
+	// Holes in the dense storages.
+	for (int i = 0; i < Items; i += 11)
+		World::delComponent<Collectable>(ents[i]);
+	for (int i = 0; i < Items; i += 13)
+		World::delComponent<Renderable>(ents[i]);
+}
+
+// A copy of b's first n bytes, with byte flip (if not negative) inverted.
+static void copy(const Buffer& b, Buffer& out, size_type n, index_type flip = -1) {
+	std::vector<std::byte> bytes(b.data(), b.data() + n);
+	if (flip >= 0)
+		bytes[flip] = ~bytes[flip];
+	out.assign(bytes.data(), n);
+}
+
+int main() {
+	populate();
+
+	Buffer a, b;
+	World::snapshot(a);
+	auto start = Clock::now();
+	for (int i = 0; i < Runs; ++i)
+		World::snapshot(b);
+	const double snapshotMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / Runs;
+	bool restored = true;
+	start = Clock::now();
+	for (int i = 0; i < Runs; ++i)
+		restored &= World::restore(a);
+	const double restoreMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / Runs;
+	printf("%d bytes: snapshot %.3fms, restore %.3fms\n\n", a.size(), snapshotMs, restoreMs);
+
+	World::snapshot(b);
+	check("restore accepts a snapshot", restored);
+	check("round trip gives the same bytes", Buffer::diff(a, b) == Buffer::Same && a.checksum() == b.checksum());
+
+	Buffer c;
+	copy(a, c, a.size());
+	check("restore accepts assigned bytes", World::restore(c));
+	copy(a, c, a.size() - 1);
+	check("restore refuses a truncated buffer", !World::restore(c));
+	copy(a, c, a.size() / 2);
+	check("restore refuses half a buffer", !World::restore(c));
+	copy(a, c, a.size(), a.size() / 2);
+	check("restore refuses a damaged buffer", !World::restore(c));
+	c.clear();
+	c.put(std::uint64_t{42});
+	c.seal();
+	check("restore refuses a foreign buffer", !World::restore(c));
+	c.clear();
+	check("restore refuses an empty buffer", !World::restore(c));
+
+	World::snapshot(b);
+	check("refused buffers leave the World as it was", Buffer::diff(a, b) == Buffer::Same);
+
+	bool threw = false;
+	try {
+		Buffer::Reader r(c);
+		std::uint64_t w;
+		r.get(w);
+	} catch (const std::out_of_range&) {
+		threw = true;
+	}
+	check("reading past the end throws", threw);
+	return failures > 0;
+}
@@ -0,0 +1,97 @@
+// Copyright (C) 2025 Moshe Sulamy
+
+// Spawns a stress layout of collectable items one entity at a time
+// (Entity::create + addAll, as the layouts do) and with the batch APIs
+// (World::createEntities, World::reserve, batched World::addComponents),
+// reporting the time and the number of heap allocations each takes.
+// Each run forks, so both start from an empty World.
+// Build with -DBAGEL_BENCHMARKS=ON.
+
+#include "gold_miner_ecs.h"
+#include "bagel.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace bagel;
+using namespace goldminer;
+using Clock = std::chrono::steady_clock;
+
+static long allocations = 0;
+
+#ifdef __GLIBC__
+extern "C" void* __libc_malloc(std::size_t);
+extern "C" void* __libc_realloc(void*, std::size_t);
+extern "C" void* malloc(std::size_t n) { ++allocations; return __libc_malloc(n); }
+extern "C" void* realloc(void* p, std::size_t n) { ++allocations; return __libc_realloc(p, n); }
+#endif
+void* operator new(std::size_t n, std::align_val_t a) {
+	++allocations;
+	return aligned_alloc(static_cast<std::size_t>(a), (n + static_cast<std::size_t>(a)-1) & ~(static_cast<std::size_t>(a)-1));
+}
+void operator delete(void* p, std::align_val_t) noexcept { free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { free(p); }
+
+struct Items
+{
+	std::vector<Position>	pos;
+	std::vector<Renderable>	sprite;
+	std::vector<ItemType>	type;
+	std::vector<Value>		value;
+	std::vector<Weight>		weight;
+	std::vector<Collectable> tag;
+
+	explicit Items(int n) : pos(n), sprite(n), type(n), value(n), weight(n), tag(n) {
+		for (int i = 0; i < n; ++i) {
+			pos[i] = {float(i % 1280), float(i / 1280)};
+			sprite[i] = {SPRITE_GOLD + i % 5};
+			type[i] = {ItemType::Type(i % 5)};
+			value[i] = {50 * (i % 5 + 1)};
+			weight[i] = {1.0f + i % 3};
+		}
+	}
+};
+
+static void oneByOne(const Items& items, int n) {
+	for (int i = 0; i < n; ++i) {
+		Entity e = Entity::create();
+		e.addAll(items.pos[i], items.sprite[i], items.type[i], items.value[i], items.weight[i], items.tag[i]);
+	}
+}
+
+static void batched(const Items& items, int n) {
+	std::vector<ent_type> ents(n);
+	World::createEntities(n, ents.data());
+	World::reserve<Position, Renderable, ItemType, Value, Weight, Collectable>(n);
+	World::addComponents<Position, Renderable, ItemType, Value, Weight, Collectable>({ents.data(), n},
+		{items.pos.data(), n}, {items.sprite.data(), n}, {items.type.data(), n},
+		{items.value.data(), n}, {items.weight.data(), n}, {items.tag.data(), n});
+}
+
+template <class F>
+static void run(const char* name, int n, F&& spawn) {
+	fflush(stdout);
+	if (fork() == 0) {
+		const Items items(n);
+		const long before = allocations;
+		const auto start = Clock::now();
+		spawn(items, n);
+		const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		printf("%-12s %7d items: %8.2fms, %5ld allocations\n", name, n, ms, allocations - before);
+		fflush(stdout);
+		_exit(0);
+	}
+	wait(nullptr);
+}
+
+int main() {
+	for (int n : {1000, 100000}) {
+		run("one by one", n, oneByOne);
+		run("batched", n, batched);
+	}
+	return 0;
+}
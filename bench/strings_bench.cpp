@@ -0,0 +1,73 @@
+// Copyright (C) 2025 Moshe Sulamy
+
+// Labels n entities from a pool of distinct names, once as std::string and
+// once as interned symbols (bagel::Strings, as Name stores them), reporting
+// the heap each takes and the time to find every entity with a given label.
+// Build with -DBAGEL_BENCHMARKS=ON.
+
+#include "gold_miner_ecs.h"
+#include "bagel.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <malloc.h>
+#include <string>
+#include <vector>
+
+using namespace bagel;
+using Clock = std::chrono::steady_clock;
+
+static std::size_t heap() {
+	const struct mallinfo2 m = mallinfo2();
+	return m.uordblks + m.hblkhd;
+}
+
+template <class F>
+static double millis(F&& f) {
+	double best = 1e30;
+	for (int run = 0; run < 5; ++run) {
+		const auto start = Clock::now();
+		f();
+		best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+	}
+	return best;
+}
+
+static std::string label(int i) { return "goldminer.item." + std::to_string(i % 1000); }
+
+int main() {
+	constexpr int N = 1000000, Queries = 20;
+	std::vector<std::string> strings;
+	std::vector<symbol_type> symbols;
+	strings.reserve(N);
+	symbols.reserve(N);
+
+	std::size_t before = heap();
+	for (int i = 0; i < N; ++i)
+		strings.push_back(label(i));
+	const double stringMB = double(heap() - before) / (1 << 20);
+	before = heap();
+	for (int i = 0; i < N; ++i)
+		symbols.push_back(Strings::intern(label(i)));
+	const double symbolMB = double(heap() - before) / (1 << 20);
+
+	long found = 0;
+	const double stringMs = millis([&] {
+		for (int q = 0; q < Queries; ++q) {
+			const std::string wanted = label(q*37);
+			found += std::count(strings.begin(), strings.end(), wanted);
+		}
+	});
+	const double symbolMs = millis([&] {
+		for (int q = 0; q < Queries; ++q) {
+			const symbol_type wanted = Strings::intern(label(q*37));
+			found += std::count(symbols.begin(), symbols.end(), wanted);
+		}
+	});
+
+	const Strings::Stats s = Strings::stats();
+	printf("%d labels, %d distinct (%zu bytes interned, %zu reserved)\n", N, s.count, s.bytes, s.reserved);
+	printf("std::string  %8.2f MB  %8.2fms for %d lookups\n", stringMB, stringMs, Queries);
+	printf("symbol       %8.2f MB  %8.2fms for %d lookups\n", symbolMB, symbolMs, Queries);
+	return found == 0;
+}
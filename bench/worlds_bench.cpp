@@ -0,0 +1,76 @@
+// Copyright (C) 2025 Moshe Sulamy
+
+// Runs the same headless simulation in 1..N Worlds at once, one per thread
+// (BAGEL_THREAD_WORLDS), reporting total frames per second. Every World
+// must end in the same state as a World run alone.
+// Build with -DBAGEL_BENCHMARKS=ON.
+
+#include "gold_miner_ecs.h"
+#include "bagel.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#ifndef BAGEL_THREAD_WORLDS
+#error worlds_bench needs BAGEL_THREAD_WORLDS
+#endif
+
+using namespace bagel;
+using namespace goldminer;
+using Clock = std::chrono::steady_clock;
+
+constexpr int Entities = 20000, Frames = 200;
+
+// Moves the moles and bounces them off the screen edges, toggling a
+// LifeTime on the ones that bounced. Returns a checksum of the positions.
+static double simulate() {
+	for (int i = 0; i < Entities; ++i) {
+		Entity e = Entity::create();
+		e.addAll(Position{float(i % 1280), float(i % 720)}, Velocity{1.0f + i % 7, 0.5f}, Mole{});
+	}
+	for (int f = 0; f < Frames; ++f) {
+		World::view<Position, Velocity, Mole>().each([](ent_type e, SoAStorage<Position>::Ref pos, SoAStorage<Velocity>::Ref vel, SoAStorage<Mole>::Ref) {
+			Position p = pos;
+			Velocity v = vel;
+			p.x += v.dx;
+			p.y += v.dy;
+			if (p.x < 0 || p.x > 1280) {
+				v.dx = -v.dx;
+				vel = v;
+				if (World::mask(e).test(Component<LifeTime>::Bit))
+					World::delComponent<LifeTime>(e);
+				else World::addComponent(e, LifeTime{});
+			}
+			pos = p;
+		});
+	}
+	double sum = 0;
+	World::view<Position>().each([&](ent_type, SoAStorage<Position>::Ref pos) {
+		const Position p = pos;
+		sum += p.x + p.y;
+	});
+	return sum;
+}
+
+int main() {
+	const double expected = simulate();
+	const int cores = std::max(1u, std::thread::hardware_concurrency());
+	printf("%d entities, %d frames per world, %d hardware threads\n", Entities, Frames, cores);
+	for (int worlds = 1; worlds <= 2*cores; worlds *= 2) {
+		std::vector<double> sums(worlds);
+		const auto start = Clock::now();
+		std::vector<std::thread> threads;
+		for (int w = 0; w < worlds; ++w)
+			threads.emplace_back([&sums, w] { sums[w] = simulate(); });
+		for (std::thread& t : threads)
+			t.join();
+		const double s = std::chrono::duration<double>(Clock::now() - start).count();
+		int same = 0;
+		for (double sum : sums)
+			same += sum == expected;
+		printf("%3d worlds: %8.0f frames/s (%d of %d match the lone world)\n", worlds, worlds*Frames / s, same, worlds);
+	}
+	return 0;
+}
@@ -4,23 +4,40 @@
  */
 #include "gold_miner_ecs.h"
 #include "bagel.h"
+#include "bagel_scheduler.h"
 #include "sprite_manager.h"
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_render.h>
 #include <cmath>
 #include <iostream>
 #include "debug_draw.h"
-#include <unordered_map>
 #include <vector>
 
 
 namespace goldminer {
     b2WorldId gWorld = b2_nullWorldId;
-    int player_id = 0; // Default to 0 = no winner / tie
-    bool game_over = false;
 
     using namespace bagel;
 
+    /**
+     * @brief Finds an entity of a player that has component T.
+     *
+     * Uses the PlayerInfo::playerID index, so the cost depends only on the
+     * number of entities owned by that player. Index lists are unordered, so
+     * T should be one that only a single entity of the player has, e.g.
+     * PlayerInput for the player itself (its rope also has a Position).
+     *
+     * @param playerID The player to look up.
+     * @return The entity, or an id of -1 if the player has none with T.
+     */
+    template <class T>
+    static ent_type FindPlayerEntity(int playerID) {
+        for (ent_type e : World::index<PlayerInfo, &PlayerInfo::playerID>(playerID))
+            if (World::mask(e).test(Component<T>::Bit))
+                return e;
+        return {-1};
+    }
+
     void initBox2DWorld () {
         b2WorldDef worldDef = b2DefaultWorldDef();
         worldDef.gravity = { 0.0f, 9.8f };
@@ -33,6 +50,23 @@ namespace goldminer {
         b2World_Draw(gWorld, &gDebugDraw);
     }
 
+    /**
+     * @brief Clears the previous match so a new one starts from an empty World.
+     *
+     * Rewinds the ECS and the Match resource with World::reset() and replaces gWorld with a fresh
+     * Box2D world, which frees every body and joint at once. The remove hooks
+     * do not run, so only the bodies' entity user data is freed here.
+     */
+    void ResetMatch() {
+        World::view<PhysicsBody>().each([](ent_type, PhysicsBody& phys) {
+            delete static_cast<ent_type*>(b2Body_GetUserData(phys.bodyId));
+        });
+        World::reset();
+        if (b2World_IsValid(gWorld))
+            b2DestroyWorld(gWorld);
+        initBox2DWorld();
+    }
+
 
     //----------------------------------
     /// @section Entity Creation Functions
@@ -57,7 +91,6 @@ namespace goldminer {
             Velocity{},
             Renderable{SPRITE_PLAYER_IDLE},
             PlayerInfo{playerID},
-            Score{0},
             PlayerInput{}
         );
 
@@ -88,29 +121,12 @@ namespace goldminer {
         Entity e = Entity::create();
 
         // Find player position
-        Position playerPos;
-        bool foundPlayer = false;
-
-        Mask playerMask;
-        playerMask.set(Component<Position>::Bit);
-        playerMask.set(Component<PlayerInfo>::Bit);
-
-        for (id_type id = 0; id <= World::maxId().id; ++id) {
-            ent_type ent{id};
-            if (!World::mask(ent).test(playerMask)) continue;
-
-            const auto& pinfo = World::getComponent<PlayerInfo>(ent);
-            if (pinfo.playerID == playerID) {
-                playerPos = World::getComponent<Position>(ent);
-                foundPlayer = true;
-                break;
-            }
-        }
-
-        if (!foundPlayer) {
+        ent_type player = FindPlayerEntity<PlayerInput>(playerID);
+        if (player.id < 0) {
             std::cerr << "[CreateRope] ERROR: Could not find player " << playerID << " to attach rope!\n";
             return -1;
         }
+        Position playerPos = World::getComponent<Position>(player);
 
         // Get player sprite size
         SDL_Rect rect = GetSpriteSrcRect(SPRITE_PLAYER_IDLE);
@@ -522,15 +538,6 @@ namespace goldminer {
         return e.entity().id;
     }
 
-    /**
-     * @brief Creates the game timer entity.
-     */
-    id_type CreateTimer() {
-        Entity e = Entity::create();
-        e.add(GameTimer{60.0f});
-        return e.entity().id;
-    }
-
     /**
      * @brief Creates a UI entity for a given player.
      */
@@ -583,38 +590,13 @@ namespace goldminer {
             }
         }
 
-        Mask mask;
-        mask.set(Component<PlayerInput>::Bit);
-        mask.set(Component<PlayerInfo>::Bit);
-
-        Mask timerMask;
-        timerMask.set(Component<GameTimer>::Bit);
-        timerMask.set(Component<PlayerInfo>::Bit);
-
-        for (id_type id = 0; id <= World::maxId().id; ++id) {
-            ent_type ent{id};
-            if (!World::mask(ent).test(mask)) continue;
-
-            auto& input = World::getComponent<PlayerInput>(ent);
-            const auto& player = World::getComponent<PlayerInfo>(ent);
+        const Match& match = World::resource<Match>();
+        World::view<PlayerInput, PlayerInfo>().cached().each([&](ent_type, PlayerInput& input, const PlayerInfo& player) {
             int pid = player.playerID;
+            if (!Match::IsPlayer(pid)) return;
 
             // Check if this player's timer is still running
-            bool hasTime = true;
-
-            for (id_type tid = 0; tid <= World::maxId().id; ++tid) {
-                ent_type timerEnt{tid};
-                if (!World::mask(timerEnt).test(timerMask)) continue;
-
-                const auto& timerPlayer = World::getComponent<PlayerInfo>(timerEnt);
-                if (timerPlayer.playerID != pid) continue;
-
-                const auto& timer = World::getComponent<GameTimer>(timerEnt);
-                if (timer.timeLeft <= 0.0f) {
-                    hasTime = false;
-                    break;
-                }
-            }
+            bool hasTime = match.timeLeft[pid-1] > 0.0f;
 
             // Set input based on player ID and key pressed
             if (pid == 1) {
@@ -622,7 +604,7 @@ namespace goldminer {
             } else if (pid == 2) {
                 input.sendRope = enterPressed && hasTime;
             }
-        }
+        });
     }
 
 
@@ -630,19 +612,6 @@ namespace goldminer {
      * @brief Oscillates rope entities that are currently at rest.
      */
     void RopeSwingSystem() {
-        static std::unordered_map<id_type, float> swingDirections;
-
-        Mask ropeMask;
-        ropeMask.set(Component<RoperTag>::Bit);
-        ropeMask.set(Component<Rotation>::Bit);
-        ropeMask.set(Component<RopeControl>::Bit);
-        ropeMask.set(Component<PhysicsBody>::Bit);
-        ropeMask.set(Component<PlayerInfo>::Bit);
-
-        Mask playerMask;
-        playerMask.set(Component<Position>::Bit);
-        playerMask.set(Component<PlayerInfo>::Bit);
-
         const float maxSwingAngle = 75.0f; // Bigger swing range → looks better
         const float swingSpeed = 90.0f;    // degrees per second → faster swing
         const float deltaTime = 1.0f / 60.0f; // assuming ~60 FPS fixed timestep
@@ -650,53 +619,31 @@ namespace goldminer {
         constexpr float PPM = 50.0f;
         constexpr float ropeLength = 80.0f; // rope visible length → tune visually
 
-        for (id_type id = 0; id <= World::maxId().id; ++id) {
-            ent_type rope{id};
-            if (!World::mask(rope).test(ropeMask)) continue;
-
-            auto& rotation = World::getComponent<Rotation>(rope);
-            auto& ropeControl = World::getComponent<RopeControl>(rope);
-            auto& phys = World::getComponent<PhysicsBody>(rope);
-            auto& ropePlayerInfo = World::getComponent<PlayerInfo>(rope);
+        World::view<RoperTag, Rotation, RopeControl, PhysicsBody, PlayerInfo>().cached().each([&](
+                ent_type rope, Rotation& rotation, RopeControl& ropeControl,
+                PhysicsBody& phys, PlayerInfo& ropePlayerInfo) {
+            id_type id = rope.id;
 
             if (ropeControl.state == RopeControl::State::AtRest) {
-                // Initialize swing direction if first time
-                if (swingDirections.find(id) == swingDirections.end()) {
-                    swingDirections[id] = 1.0f;
-                }
-
                 // Update angle
-                rotation.angle += swingDirections[id] * swingSpeed * deltaTime;
+                rotation.angle += ropeControl.swingDirection * swingSpeed * deltaTime;
 
                 // Clamp angle and reverse direction
                 if (rotation.angle > maxSwingAngle) {
                     rotation.angle = maxSwingAngle;
-                    swingDirections[id] = -1.0f;
+                    ropeControl.swingDirection = -1.0f;
                 } else if (rotation.angle < -maxSwingAngle) {
                     rotation.angle = -maxSwingAngle;
-                    swingDirections[id] = 1.0f;
+                    ropeControl.swingDirection = 1.0f;
                 }
 
                 // Find matching player
-                Position playerPos{};
-                bool foundPlayer = false;
-
-                for (id_type pid = 0; pid <= World::maxId().id; ++pid) {
-                    ent_type player{pid};
-                    if (!World::mask(player).test(playerMask)) continue;
-
-                    const auto& playerInfo = World::getComponent<PlayerInfo>(player);
-                    if (playerInfo.playerID == ropePlayerInfo.playerID) {
-                        playerPos = World::getComponent<Position>(player);
-                        foundPlayer = true;
-                        break;
-                    }
-                }
-
-                if (!foundPlayer) {
+                ent_type player = FindPlayerEntity<PlayerInput>(ropePlayerInfo.playerID);
+                if (player.id < 0) {
                     std::cerr << "[RopeSwingSystem] ERROR: Could not find player for rope " << id << "\n";
-                    continue;
+                    return;
                 }
+                Position playerPos = World::getComponent<Position>(player);
 
                 // Use the same winch offset as your current CreateRope()
                 SDL_Rect rect = GetSpriteSrcRect(SPRITE_PLAYER_IDLE);
@@ -735,7 +682,7 @@ namespace goldminer {
                 // Not at rest → allow gravity
                 b2Body_SetGravityScale(phys.bodyId, 1.0f);
             }
-        }
+        });
     }
 
     /**
@@ -743,49 +690,21 @@ namespace goldminer {
      */
 
     void RopeExtensionSystem() {
-        Mask mask;
-        mask.set(Component<RoperTag>::Bit);
-        mask.set(Component<RopeControl>::Bit);
-        mask.set(Component<Length>::Bit);
-        mask.set(Component<Position>::Bit);
-        mask.set(Component<PlayerInfo>::Bit);
-        mask.set(Component<PhysicsBody>::Bit);
-
         constexpr float MAX_LENGTH = 800.0f;
         constexpr float EXTENSION_SPEED = 600.0f; // pixels/sec
         constexpr float RETRACTION_SPEED = 900.0f;
         constexpr float PPM = 50.0f;
         const float deltaTime = 1.0f / 60.0f;
 
-        for (id_type id = 0; id <= World::maxId().id; ++id) {
-            ent_type rope{id};
-            if (!World::mask(rope).test(mask)) continue;
-
-            auto& ropeControl = World::getComponent<RopeControl>(rope);
-            auto& length = World::getComponent<Length>(rope);
+        World::view<RoperTag, RopeControl, Length, Position, PlayerInfo, PhysicsBody>().cached().each([&](
+                ent_type rope, RopeControl& ropeControl, Length& length, const Position&,
+                PlayerInfo& ropeOwner, PhysicsBody& phys) {
             auto& rotation = World::getComponent<Rotation>(rope);
-            auto& phys = World::getComponent<PhysicsBody>(rope);
-            auto& ropeOwner = World::getComponent<PlayerInfo>(rope);
 
             // Find player position
-            Position playerPos{};
-            bool foundPlayer = false;
-            Mask playerMask;
-            playerMask.set(Component<Position>::Bit);
-            playerMask.set(Component<PlayerInfo>::Bit);
-            ent_type playerEntity = {};
-            for (id_type pid = 0; pid <= World::maxId().id; ++pid) {
-                ent_type player{pid};
-                if (!World::mask(player).test(playerMask)) continue;
-                const auto& pinfo = World::getComponent<PlayerInfo>(player);
-                if (pinfo.playerID == ropeOwner.playerID) {
-                    playerPos = World::getComponent<Position>(player);
-                    playerEntity = player;
-                    foundPlayer = true;
-                    break;
-                }
-            }
-            if (!foundPlayer) continue;
+            ent_type playerEntity = FindPlayerEntity<PlayerInput>(ropeOwner.playerID);
+            if (playerEntity.id < 0) return;
+            Position playerPos = World::getComponent<Position>(playerEntity);
 
             // Handle input: if at rest and Enter pressed, start extending
             auto& input = World::getComponent<PlayerInput>(playerEntity);
@@ -836,7 +755,7 @@ namespace goldminer {
 
                     std::cout << "[DEBUG] Checking weight for entity " << attached.id << std::endl;
 
-                    if (World::mask(attached).test(Component<Weight>::Bit)) {
+                    if (World::alive(attached) && World::mask(attached).test(Component<Weight>::Bit)) {
                         float itemWeight = World::getComponent<Weight>(attached).w;
                         std::cout << "[DEBUG] Weight = " << itemWeight << std::endl;
                         weightMultiplier = std::max(0.1f, itemWeight);
@@ -878,7 +797,7 @@ namespace goldminer {
                 b2Body_SetAngularVelocity(phys.bodyId, 0.0f);
                 b2Body_SetGravityScale(phys.bodyId, 0.0f);
             }
-        }
+        });
     }
 
     /**
@@ -919,6 +838,8 @@ namespace goldminer {
 
             ent_type entA = *userDataA;
             ent_type entB = *userDataB;
+            if (!World::alive(entA) || !World::alive(entB))
+                continue;
             std::cout << "Hit detected between Entity " << entA.id << " and Entity " << entB.id << std::endl;
 
             // Rope vs Collectable
@@ -943,6 +864,9 @@ namespace goldminer {
         auto& ropePhys = World::getComponent<PhysicsBody>(rope);
         auto& itemPhys = World::getComponent<PhysicsBody>(collectable);
 
+        // GrabbedJoint lands at the next flush; Box2D already knows this frame's joints
+        if (b2Body_GetJointCount(ropePhys.bodyId) > 0 || b2Body_GetJointCount(itemPhys.bodyId) > 0) return;
+
         b2Body_SetType(itemPhys.bodyId, b2_dynamicBody);
 
         b2WeldJointDef jointDef = b2DefaultWeldJointDef();
@@ -951,8 +875,9 @@ namespace goldminer {
         jointDef.collideConnected = false;
 
         b2JointId jointId = b2CreateWeldJoint(goldminer::gWorld, &jointDef);
-        World::addComponent<GrabbedJoint>(rope, GrabbedJoint{jointId, collectable.id});
-        World::addComponent<GrabbedJoint>(collectable, GrabbedJoint{jointId, rope.id});
+        CommandBuffer& commands = CommandBuffer::local();
+        commands.add<GrabbedJoint>(rope, GrabbedJoint{jointId, collectable.id});
+        commands.add<GrabbedJoint>(collectable, GrabbedJoint{jointId, rope.id});
         auto& ropeControl = World::getComponent<RopeControl>(rope);
         ropeControl.state = RopeControl::State::Retracting;
 
@@ -972,19 +897,17 @@ namespace goldminer {
      * It logs rope vs item collisions if their positions intersect.
      */
     void DebugCollisionSystem() {
+        std::vector<ent_type> collidables;
+        World::view<Position, Collidable>().cached().each([&](ent_type ent, const Position&) {
+            collidables.push_back(ent);
+        });
 
-        for (id_type a = 0; a <= World::maxId().id; ++a) {
-            ent_type entA{a};
-            if (!World::mask(entA).test(Component<Position>::Bit)) continue;
-            if (!World::mask(entA).test(Component<Collidable>::Bit)) continue;
-
+        for (std::size_t i = 0; i < collidables.size(); ++i) {
+            ent_type entA = collidables[i];
             const Position& posA = World::getComponent<Position>(entA);
 
-            for (id_type b = a + 1; b <= World::maxId().id; ++b) {
-                ent_type entB{b};
-                if (!World::mask(entB).test(Component<Position>::Bit)) continue;
-                if (!World::mask(entB).test(Component<Collidable>::Bit)) continue;
-
+            for (std::size_t j = i + 1; j < collidables.size(); ++j) {
+                ent_type entB = collidables[j];
                 const Position& posB = World::getComponent<Position>(entB);
 
                 float sizeA = 20.0f;
@@ -993,7 +916,7 @@ namespace goldminer {
                 SDL_FRect rectB = {posB.x, posB.y, sizeB, sizeB};
 
                 if (SDL_HasRectIntersectionFloat(&rectA, &rectB)) {
-                    std::cout << "[DEBUG] Approximate collision: " << a << " vs " << b << std::endl;
+                    std::cout << "[DEBUG] Approximate collision: " << entA.id << " vs " << entB.id << std::endl;
 
                     bool aIsRope = World::mask(entA).test(Component<RoperTag>::Bit);
                     bool bIsItem = World::mask(entB).test(Component<ItemType>::Bit);
@@ -1012,22 +935,12 @@ namespace goldminer {
      * @brief Pulls collected items towards the player.
      */
     void PullObjectSystem() {
-        Mask mask;
-        mask.set(Component<Collidable>::Bit);
-        mask.set(Component<Position>::Bit);
-
-        Mask optional;
-        optional.set(Component<RoperTag>::Bit);
-        optional.set(Component<Collectable>::Bit);
-        optional.set(Component<ItemType>::Bit);
-        optional.set(Component<PlayerInfo>::Bit);
-        optional.set(Component<Weight>::Bit);
-
-        for (id_type id = 0; id <= World::maxId().id; ++id) {
-            ent_type ent{id};
-            if (!World::mask(ent).test(mask)) continue;
-            // No logic implemented yet
-        }
+        World::view<Collidable, Position>()
+            .optional<RoperTag, Collectable, ItemType, PlayerInfo, Weight>()
+            .cached()
+            .each([](ent_type, const Position&, bool, bool, const ItemType*, PlayerInfo*, const Weight*) {
+                // No logic implemented yet
+            });
     }
 
      /**
@@ -1042,15 +955,14 @@ namespace goldminer {
      * For each such entity:
      * - The system finds the rope it's attached to via `GrabbedJoint.attachedEntityId`
      * - Uses the rope's `PlayerInfo` to determine which player collected the item
-     * - Increases the player's `Score` by the item's `Value`
+     * - Increases the player's score in the `Match` resource by the item's `Value`
      * - Adds `ScoredTag` to mark it as already processed
      *
      * Expected components:
      * - Collectable
      * - Value
      * - GrabbedJoint
-     * - Score (for each player)
-     * - PlayerInfo (both for rope and score entities)
+     * - PlayerInfo (on the rope)
      *
      * Typical use: Call this system once per frame during the game loop,
      * after `PullObjectSystem()` has updated object positions and grab logic.
@@ -1059,65 +971,37 @@ namespace goldminer {
         using namespace bagel;
         using namespace goldminer;
 
-        Mask itemMask;
-        itemMask.set(Component<Collectable>::Bit);
-        itemMask.set(Component<Value>::Bit);
-        itemMask.set(Component<GrabbedJoint>::Bit);
-
-        Mask scoreMask;
-        scoreMask.set(Component<Score>::Bit);
-        scoreMask.set(Component<PlayerInfo>::Bit);
-
-        for (id_type id = 0; id <= World::maxId().id; ++id) {
-            ent_type ent{id};
+        Match& match = World::resource<Match>();
 
-            if (!World::mask(ent).test(itemMask)) continue;
-            if (World::mask(ent).test(Component<ScoredTag>::Bit)) continue; // ✅ already processed
-
-            const Value& value = World::getComponent<Value>(ent);
-            const GrabbedJoint& joint = World::getComponent<GrabbedJoint>(ent);
-            if (joint.attachedEntityId == -1) continue;
+        // ScoredTag entities were already processed
+        World::view<Collectable, Value, GrabbedJoint>().without<ScoredTag>().cached().each([&](
+                ent_type ent, const Value& value, const GrabbedJoint& joint) {
+            if (joint.attachedEntityId == -1) return;
 
             ent_type ropeEnt{joint.attachedEntityId};
-            if (!World::mask(ropeEnt).test(Component<PlayerInfo>::Bit)) continue;
+            if (!World::alive(ropeEnt) || !World::mask(ropeEnt).test(Component<PlayerInfo>::Bit)) return;
 
             const PlayerInfo& player = World::getComponent<PlayerInfo>(ropeEnt);
-            int pid = player.playerID;
-
-            for (id_type sid = 0; sid <= World::maxId().id; ++sid) {
-                ent_type scoreEnt{sid};
-                if (!World::mask(scoreEnt).test(scoreMask)) continue;
-
-                const PlayerInfo& scorePlayer = World::getComponent<PlayerInfo>(scoreEnt);
-                if (scorePlayer.playerID != pid) continue;
-
-                Score& score = World::getComponent<Score>(scoreEnt);
-                score.points += value.amount;
-
-                World::addComponent<ScoredTag>(ent, {}); // ✅ mark as processed
-                break;
-            }
-        }
+            if (!Match::IsPlayer(player.playerID)) return;
+            match.score[player.playerID-1] += value.amount;
+            CommandBuffer::local().add<ScoredTag>(ent, {}); // ✅ mark as processed
+        });
     }
 
     /**
      * @brief Renders all entities with a position and sprite.
+     *
+     * Renderable is a shared component, so its entities are already grouped
+     * by sprite: each sprite's texture and source rect are looked up once and
+     * its entities drawn in one run.
      */
     void RenderSystem(SDL_Renderer* renderer) {
         using namespace bagel;
         using namespace goldminer;
+        using Sprites = SharedSetStorage<Renderable>;
 
-        Mask mask;
-        mask.set(Component<Renderable>::Bit);
-        mask.set(Component<Position>::Bit);
-
-        for (id_type id = 0; id <= World::maxId().id; ++id) {
-            ent_type ent{id};
-            if (!World::mask(ent).test(mask)) continue;
-
-            const Position& pos = World::getComponent<Position>(ent);
-            const Renderable& render = World::getComponent<Renderable>(ent);
-
+        for (index_type h = 0; h < Sprites::values(); ++h) {
+            const Renderable& render = Sprites::value(h);
             if (render.spriteID < 0 || render.spriteID >= SPRITE_COUNT) continue;
 
             SDL_Rect rect = GetSpriteSrcRect(static_cast<SpriteID>(render.spriteID));
@@ -1130,14 +1014,19 @@ namespace goldminer {
                 static_cast<float>(rect.h)
             };
 
-            SDL_FRect dest = {
-                pos.x,
-                pos.y,
-                src.w,
-                src.h
-            };
+            for (ent_type e : Sprites::entities(h)) {
+                if (!World::mask(e).test(Component<Position>::Bit)) continue;
+                const Position pos = World::getComponent<Position>(e);
 
-            SDL_RenderTexture(renderer, texture, &src, &dest);
+                SDL_FRect dest = {
+                    pos.x,
+                    pos.y,
+                    src.w,
+                    src.h
+                };
+
+                SDL_RenderTexture(renderer, texture, &src, &dest);
+            }
         }
     }
 
@@ -1175,41 +1064,9 @@ namespace goldminer {
 
         constexpr float PPM = 50.0f;
 
-        Mask ropeMask;
-        ropeMask.set(Component<RoperTag>::Bit);
-        ropeMask.set(Component<PhysicsBody>::Bit);
-        ropeMask.set(Component<PlayerInfo>::Bit);
-
-        Mask playerMask;
-        playerMask.set(Component<Position>::Bit);
-        playerMask.set(Component<PlayerInfo>::Bit);
-
-        for (bagel::id_type id = 0; id <= bagel::World::maxId().id; ++id) {
-            bagel::ent_type ent{id};
-
-            if (bagel::World::mask(ent).test(bagel::Component<goldminer::RoperTag>::Bit) &&
-                bagel::World::mask(ent).test(bagel::Component<goldminer::PhysicsBody>::Bit)) {
-                const auto& phys = bagel::World::getComponent<goldminer::PhysicsBody>(ent);
-                b2Transform tf = b2Body_GetTransform(phys.bodyId);
-                //std::cout << "ROPE at: " << tf.p.x * 50 << ", " << tf.p.y * 50 << std::endl;
-                }
-
-            if (bagel::World::mask(ent).test(bagel::Component<goldminer::ItemType>::Bit) &&
-                bagel::World::mask(ent).test(bagel::Component<goldminer::PhysicsBody>::Bit)) {
-                const auto& phys = bagel::World::getComponent<goldminer::PhysicsBody>(ent);
-                b2Transform tf = b2Body_GetTransform(phys.bodyId);
-                //std::cout << "ITEM at: " << tf.p.x * 50 << ", " << tf.p.y * 50 << std::endl;
-                }
-        }
-
-        for (id_type id = 0; id <= World::maxId().id; ++id) {
-            ent_type rope{id};
-            if (!World::mask(rope).test(ropeMask)) continue;
-
-            const PhysicsBody& phys = World::getComponent<PhysicsBody>(rope);
-            const PlayerInfo& ropeOwner = World::getComponent<PlayerInfo>(rope);
-
-            if (!b2Body_IsValid(phys.bodyId)) continue;
+        World::view<RoperTag, PhysicsBody, PlayerInfo>().cached().each([&](
+                ent_type, const PhysicsBody& phys, const PlayerInfo& ropeOwner) {
+            if (!b2Body_IsValid(phys.bodyId)) return;
 
             b2Transform tf = b2Body_GetTransform(phys.bodyId);
             SDL_FPoint ropeTip = {
@@ -1218,23 +1075,15 @@ namespace goldminer {
         };
 
             // Find the matching player
-            for (id_type pid = 0; pid <= World::maxId().id; ++pid) {
-                ent_type player{pid};
-                if (!World::mask(player).test(playerMask)) continue;
-
-                const PlayerInfo& playerInfo = World::getComponent<PlayerInfo>(player);
-                if (playerInfo.playerID != ropeOwner.playerID) continue;
-
-                const Position& playerPos = World::getComponent<Position>(player);
-
-                SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-                SDL_RenderLine(renderer,
-                               playerPos.x +40 , playerPos.y + 120,  // Approx. center of player
-                               ropeTip.x, ropeTip.y);               // From Box2D rope center
-
-                break;
-            }
-        }
+            ent_type player = FindPlayerEntity<PlayerInput>(ropeOwner.playerID);
+            if (player.id < 0) return;
+            Position playerPos = World::getComponent<Position>(player);
+
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+            SDL_RenderLine(renderer,
+                           playerPos.x +40 , playerPos.y + 120,  // Approx. center of player
+                           ropeTip.x, ropeTip.y);               // From Box2D rope center
+        });
     }
 
     /**
@@ -1273,42 +1122,47 @@ namespace goldminer {
      * Notes:
      * - Assumes PIXELS_PER_METER is defined globally.
      * - This system is essential for aligning sprite rendering with physics movement.
+     * - Walks the Position/PhysicsBody owning group in parallel chunks, skipping
+     *   bodies without a sprite (the ropes). The group's members are the first
+     *   rows of both storages, in the same order, so row i of the x/y columns is
+     *   filled in place from body i; each chunk only writes its own rows.
+     * - Position is only written, and marked changed, when the body moved.
      */
     void PhysicsSyncSystem() {
         using namespace bagel;
 
         constexpr float PIXELS_PER_METER = 50.0f;
 
-        Mask mask;
-        mask.set(Component<PhysicsBody>::Bit);
-        mask.set(Component<Position>::Bit);
-        mask.set(Component<Renderable>::Bit);
-
-        for (id_type id = 0; id <= World::maxId().id; ++id) {
-            ent_type ent{id};
-            if (!World::mask(ent).test(mask)) continue;
-
-            auto& phys = World::getComponent<PhysicsBody>(ent);
-            auto& pos = World::getComponent<Position>(ent);
-            const auto& render = World::getComponent<Renderable>(ent);
-
-            if (!b2Body_IsValid(phys.bodyId)) continue;
-
-            b2Transform transform = b2Body_GetTransform(phys.bodyId);
-            SDL_FPoint offset = GetSpriteOffset(render.spriteID);
-
-            pos.x = transform.p.x * PIXELS_PER_METER - offset.x;
-            pos.y = transform.p.y * PIXELS_PER_METER - offset.y;
-        }
+        const Span<float> xs = World::column<&Position::x>();
+        const Span<float> ys = World::column<&Position::y>();
+
+        Jobs::run(World::group<Position, PhysicsBody>().size(), 64, [&](index_type begin, index_type end) {
+            for (index_type i = begin; i < end; ++i) {
+                const ent_type e = Storage<Position>::type::entity(i);
+                if (!World::mask(e).test(Component<Renderable>::Bit)) continue;
+                const PhysicsBody& phys = Storage<PhysicsBody>::type::get(i);
+                if (!b2Body_IsValid(phys.bodyId)) continue;
+
+                b2Transform transform = b2Body_GetTransform(phys.bodyId);
+                SDL_FPoint offset = GetSpriteOffset(World::getComponent<Renderable>(e).spriteID);
+
+                const float x = transform.p.x * PIXELS_PER_METER - offset.x;
+                const float y = transform.p.y * PIXELS_PER_METER - offset.y;
+                if (x == xs[i] && y == ys[i]) continue; // resting bodies keep their change stamp
+                xs[i] = x;
+                ys[i] = y;
+                World::markChanged<Position>(e);
+            }
+        });
     }
 
         /**
-     * @brief Decreases the remaining time for each player with a GameTimer.
+     * @brief Decreases the remaining time of each player.
      *
      * This system is called once per frame and is responsible for updating
-     * the countdown timer of each player. It scans all entities that have both
-     * a GameTimer and PlayerInfo component, subtracts the elapsed frame time
-     * (`deltaTime`) from the timer, and clamps the result to zero if needed.
+     * the countdown timer of each player. It subtracts the elapsed frame time
+     * (`deltaTime`) from each timer in the `Match` resource, and clamps the
+     * result to zero if needed.
      *
      * This allows each player to have their own independent countdown.
      * Once the timer reaches 0, it will no longer decrease.
@@ -1320,19 +1174,11 @@ namespace goldminer {
     void GameTimerSystem(float deltaTime) {
         using namespace bagel;
 
-        Mask mask;
-        mask.set(Component<GameTimer>::Bit);
-        mask.set(Component<PlayerInfo>::Bit);
-
-        for (id_type id = 0; id <= World::maxId().id; ++id) {
-            ent_type ent{id};
-            if (!World::mask(ent).test(mask)) continue;
+        for (float& timeLeft : World::resource<Match>().timeLeft) {
+            timeLeft -= deltaTime;
 
-            GameTimer& timer = World::getComponent<GameTimer>(ent);
-            timer.timeLeft -= deltaTime;
-
-            if (timer.timeLeft < 0.0f)
-                timer.timeLeft = 0.0f;
+            if (timeLeft < 0.0f)
+                timeLeft = 0.0f;
         }
     }
 
@@ -1372,7 +1218,8 @@ namespace goldminer {
      * - The money icon + their current score
      * - The time icon + their remaining time
      *
-     * Each player's data is matched by their PlayerInfo.playerID field.
+     * Each player's score and time are read from the `Match` resource,
+     * at the slot of their PlayerInfo.playerID field.
      * The score and timer are drawn using digit sprites (SPRITE_DIGIT_0 to SPRITE_DIGIT_9),
      * instead of dynamic fonts.
      *
@@ -1383,8 +1230,6 @@ namespace goldminer {
      *
      * Expected components:
      * - UI entities: UIComponent, PlayerInfo
-     * - Score entities: Score, PlayerInfo
-     * - Timer entities: GameTimer, PlayerInfo
      *
      * @param renderer Pointer to the SDL_Renderer used for rendering
      */
@@ -1397,25 +1242,11 @@ namespace goldminer {
         constexpr float ICON_SPACING = 10.0f;
         //constexpr float NUMBER_Y_OFFSET = 4.0f;
 
+        const Match& match = World::resource<Match>();
 
-        Mask uiMask;
-        uiMask.set(Component<UIComponent>::Bit);
-        uiMask.set(Component<PlayerInfo>::Bit);
-
-        Mask scoreMask;
-        scoreMask.set(Component<Score>::Bit);
-        scoreMask.set(Component<PlayerInfo>::Bit);
-
-        Mask timerMask;
-        timerMask.set(Component<GameTimer>::Bit);
-        timerMask.set(Component<PlayerInfo>::Bit);
-
-        for (id_type id = 1; id <= World::maxId().id; ++id) {
-            ent_type uiEnt{id};
-            if (!World::mask(uiEnt).test(uiMask)) continue;
-
-            const PlayerInfo& uiPlayer = World::getComponent<PlayerInfo>(uiEnt);
+        World::view<UIComponent, PlayerInfo>().cached().each([&](ent_type, const UIComponent&, const PlayerInfo& uiPlayer) {
             int pid = uiPlayer.playerID;
+            if (!Match::IsPlayer(pid)) return;
 
             float offsetX = 5.0f + (pid-1) * PLAYER_UI_SPACING_X;
 
@@ -1426,18 +1257,7 @@ namespace goldminer {
             SDL_FRect moneySrcF = {(float)moneySrc.x, (float)moneySrc.y, (float)moneySrc.w, (float)moneySrc.h};
             SDL_RenderTexture(renderer, moneyIcon, &moneySrcF, &moneyDst);
 
-            for (id_type sid = 0; sid <= World::maxId().id; ++sid) {
-                ent_type scoreEnt{sid};
-                if (!World::mask(scoreEnt).test(scoreMask)) continue;
-
-                const PlayerInfo& scorePlayer = World::getComponent<PlayerInfo>(scoreEnt);
-                if (scorePlayer.playerID != pid) continue;
-
-                const Score& score = World::getComponent<Score>(scoreEnt);
-                DrawNumber(renderer, score.points, moneyDst.x + moneyDst.w + ICON_SPACING, moneyDst.y);
-
-                break;
-            }
+            DrawNumber(renderer, match.score[pid-1], moneyDst.x + moneyDst.w + ICON_SPACING, moneyDst.y);
 
             // === Time ===
             SDL_Texture* timeIcon = GetSpriteTexture(SPRITE_TITLE_TIME);
@@ -1446,31 +1266,19 @@ namespace goldminer {
             SDL_FRect timeSrcF = {(float)timeSrc.x, (float)timeSrc.y, (float)timeSrc.w, (float)timeSrc.h};
             SDL_RenderTexture(renderer, timeIcon, &timeSrcF, &timeDst);
 
-            for (id_type tid = 0; tid <= World::maxId().id; ++tid) {
-                ent_type timerEnt{tid};
-                if (!World::mask(timerEnt).test(timerMask)) continue;
-
-                const PlayerInfo& timerPlayer = World::getComponent<PlayerInfo>(timerEnt);
-                if (timerPlayer.playerID != pid) continue;
-
-                const GameTimer& timer = World::getComponent<GameTimer>(timerEnt);
-                int seconds = (int)std::ceil(timer.timeLeft);
-                if (seconds < 10) {
-                    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 100);  // אדום שקוף
-                    SDL_FRect bgRect = {
-                        timeDst.x + timeDst.w + ICON_SPACING - 10,  // טיפה לפני הספרות
-                        timeDst.y - 5,
-                        55,
-                        55
-                    };
-                    SDL_RenderFillRect(renderer, &bgRect);
-                }
-                DrawNumber(renderer, seconds, timeDst.x + timeDst.w + ICON_SPACING, timeDst.y );
-
-
-                break;
+            int seconds = (int)std::ceil(match.timeLeft[pid-1]);
+            if (seconds < 10) {
+                SDL_SetRenderDrawColor(renderer, 255, 0, 0, 100);  // אדום שקוף
+                SDL_FRect bgRect = {
+                    timeDst.x + timeDst.w + ICON_SPACING - 10,  // טיפה לפני הספרות
+                    timeDst.y - 5,
+                    55,
+                    55
+                };
+                SDL_RenderFillRect(renderer, &bgRect);
             }
-        }
+            DrawNumber(renderer, seconds, timeDst.x + timeDst.w + ICON_SPACING, timeDst.y );
+        });
 
     }
 
@@ -1480,30 +1288,18 @@ namespace goldminer {
  * @brief Controls the mole's horizontal movement.
  */
     void MoleSystem() {
-        Mask mask;
-        mask.set(Component<Mole>::Bit);
-        mask.set(Component<Position>::Bit);
-        mask.set(Component<Velocity>::Bit);
-
-        for (id_type id = 0; id <= World::maxId().id; ++id) {
-            ent_type ent{id};
-            if (!World::mask(ent).test(mask)) continue;
+        World::view<Mole, Position, Velocity>().cached().parallelEach([](ent_type, SoAStorage<Mole>::Ref, const Position&, const Velocity&) {
             // No logic implemented yet
-        }
+        });
     }
 
 /**
  * @brief Removes entities with a lifetime timer that expired.
  */
     void LifeTimeSystem() {
-        Mask mask;
-        mask.set(Component<LifeTime>::Bit);
-
-        for (id_type id = 0; id <= World::maxId().id; ++id) {
-            ent_type ent{id};
-            if (!World::mask(ent).test(mask)) continue;
+        World::each<LifeTime>([](ent_type, LifeTime&) {
             // No logic implemented yet
-        }
+        });
     }
 
     void Box2DDebugRenderSystem(SDL_Renderer* renderer) {
@@ -1511,122 +1307,100 @@ namespace goldminer {
     }
 
 
+    // Bodies and joints of the destroyed entities are freed by their
+    // components' remove hooks (see ReleasePhysicsBody, ReleaseGrabbedJoint).
     void DestructionSystem() {
-        Mask req = MaskBuilder{}.set<DestroyTag>().build();
-
-        // // Clean up Box2D body and user data if present
-        // if (World::mask(ent).test(Component<PhysicsBody>::Bit)) {
-        //     auto& phys = World::getComponent<PhysicsBody>(ent);
-        //     if (b2Body_IsValid(phys.bodyId)) {
-        //         void* userData = b2Body_GetUserData(phys.bodyId);
-        //         if (userData) delete static_cast<bagel::ent_type*>(userData);
-        //         b2DestroyBody(phys.bodyId);
-        //         phys.bodyId = b2_nullBodyId;
-        //     }
-        // }
-
         std::vector<ent_type> toDelete;
-        toDelete.reserve(PackedStorage<DestroyTag>::size());
+        toDelete.reserve(TagSetStorage<DestroyTag>::size());
 
-        for (std::size_t i = 0; i < PackedStorage<DestroyTag>::size(); ++i) {
-            ent_type e = PackedStorage<DestroyTag>::entity(i);
-            if (World::mask(e).test(req)) {
-                toDelete.push_back(e);
-            }
-        }
+        World::each<DestroyTag>([&](ent_type e) {
+            toDelete.push_back(e);
+        });
 
-        for (ent_type e : toDelete) {
+        for (ent_type e : toDelete)
             std::cout << "[DestructionSystem] Destroying entity " << e.id << "\n";
-            if (World::mask(e).test(Component<Position>::Bit)) World::delComponent<Position>(e);
-            if (World::mask(e).test(Component<Velocity>::Bit)) World::delComponent<Velocity>(e);
-            if (World::mask(e).test(Component<Rotation>::Bit)) World::delComponent<Rotation>(e);
-            if (World::mask(e).test(Component<Length>::Bit)) World::delComponent<Length>(e);
-            if (World::mask(e).test(Component<Renderable>::Bit)) World::delComponent<Renderable>(e);
-            if (World::mask(e).test(Component<PlayerInfo>::Bit)) World::delComponent<PlayerInfo>(e);
-            if (World::mask(e).test(Component<RopeControl>::Bit)) World::delComponent<RopeControl>(e);
-            if (World::mask(e).test(Component<ItemType>::Bit)) World::delComponent<ItemType>(e);
-            if (World::mask(e).test(Component<Value>::Bit)) World::delComponent<Value>(e);
-            if (World::mask(e).test(Component<Weight>::Bit)) World::delComponent<Weight>(e);
-            if (World::mask(e).test(Component<GrabbedJoint>::Bit)) World::delComponent<GrabbedJoint>(e);
-            if (World::mask(e).test(Component<PhysicsBody>::Bit)) World::delComponent<PhysicsBody>(e);
-            if (World::mask(e).test(Component<PlayerInput>::Bit)) World::delComponent<PlayerInput>(e);
-            if (World::mask(e).test(Component<Collectable>::Bit)) World::delComponent<Collectable>(e);
-            if (World::mask(e).test(Component<RoperTag>::Bit)) World::delComponent<RoperTag>(e);
-            if (World::mask(e).test(Component<GameOverTag>::Bit)) World::delComponent<GameOverTag>(e);
-            if (World::mask(e).test(Component<Collidable>::Bit)) World::delComponent<Collidable>(e);
-            if (World::mask(e).test(Component<DestroyTag>::Bit)) World::delComponent<DestroyTag>(e);
-        }
-
+        World::destroyEntities({toDelete.data(), static_cast<size_type>(toDelete.size())});
     }
 
     void CheckForGameOverSystem() {
         using namespace bagel;
         using namespace goldminer;
 
-        Mask timerMask;
-        timerMask.set(Component<GameTimer>::Bit);
-        timerMask.set(Component<PlayerInfo>::Bit);
-
-        Mask scoreMask;
-        scoreMask.set(Component<Score>::Bit);
-        scoreMask.set(Component<PlayerInfo>::Bit);
-
-        int playersWithTime = 0;
-        std::vector<std::pair<int, int>> playerScores; // {playerID, score}
-
-        for (id_type id = 0; id <= World::maxId().id; ++id) {
-            ent_type ent{id};
-            if (!World::mask(ent).test(timerMask)) continue;
-
-            const GameTimer& timer = World::getComponent<GameTimer>(ent);
-            const PlayerInfo& player = World::getComponent<PlayerInfo>(ent);
-
-            if (timer.timeLeft > 0.0f)
-                playersWithTime++;
+        Match& match = World::resource<Match>();
+
+        // Wait until every player's time ran out
+        for (float timeLeft : match.timeLeft)
+            if (timeLeft > 0.0f)
+                return;
+
+        // Find winner
+        const int* maxScoreIt = std::max_element(std::begin(match.score), std::end(match.score));
+        int maxScore = *maxScoreIt;
+        int winners = static_cast<int>(std::count(std::begin(match.score), std::end(match.score), maxScore));
+
+        if (winners == 1) {
+            match.winner = static_cast<int>(maxScoreIt - match.score) + 1;
+            match.over = true;
+            std::cout << "\n🎉 GAME OVER! Winner is Player " << match.winner
+                      << " with " << maxScore << " points!\n";
+        } else {
+            match.winner = 0;
+            match.over = true;
+            std::cout << "\n⚖️ GAME OVER! It's a tie between players with " << maxScore << " points!\n";
         }
+    }
 
-        // If all players have time == 0
-        if (playersWithTime == 0) {
-            // Find winner
-            for (id_type id = 0; id <= World::maxId().id; ++id) {
-                ent_type ent{id};
-                if (!World::mask(ent).test(scoreMask)) continue;
-
-                const Score& score = World::getComponent<Score>(ent);
-                const PlayerInfo& player = World::getComponent<PlayerInfo>(ent);
-
-                playerScores.emplace_back(player.playerID, score.points);
-            }
-
-            if (!playerScores.empty()) {
-                auto maxScoreIt = std::max_element(
-                    playerScores.begin(), playerScores.end(),
-                    [](const auto& a, const auto& b) {
-                        return a.second < b.second;
-                    });
-
-                int maxScore = maxScoreIt->second;
-                std::vector<int> winners;
-
-                for (const auto& p : playerScores) {
-                    if (p.second == maxScore) {
-                        winners.push_back(p.first);
-                    }
-                }
-
-                if (winners.size() == 1) {
-                    player_id = winners[0];
-                    game_over = true;
-                    std::cout << "\n🎉 GAME OVER! Winner is Player " << winners[0]
-                              << " with " << maxScore << " points!\n";
-                } else {
-                    player_id = 0;
-                    game_over = true;
-                    std::cout << "\n⚖️ GAME OVER! It's a tie between players with " << maxScore << " points!\n";
-                }
-            }
-
-        }
+    /**
+     * @brief Returns the scheduler running one frame of the Playing state.
+     *
+     * Systems are registered in the order main.cpp used to call them, each with
+     * the components and resources it touches. Printing counts as writing the
+     * Console so the log keeps its order. Systems deferring structural changes
+     * to CommandBuffer::local() write the components they add or remove; only
+     * DestructionSystem changes the World directly and writes Structure.
+     *
+     * The schedule is built on the first call; later arguments are ignored.
+     *
+     * @param renderer The SDL renderer used by the drawing systems.
+     * @param timeStep The fixed frame time passed to GameTimerSystem.
+     * @return The frame scheduler.
+     */
+    Scheduler& FrameScheduler(SDL_Renderer* renderer, float timeStep) {
+        static Scheduler frame;
+        static bool built = false;
+        if (built) return frame;
+        built = true;
+
+        frame.add<System<Reads<>, Writes<Match>>>(
+                "GameTimer", [=] { GameTimerSystem(timeStep); })
+            .add<System<Reads<RoperTag, RopeControl, PhysicsBody, PlayerInfo, Position>,
+                        Writes<Rotation, Box2DWorld, Console>>>(
+                "RopeSwing", RopeSwingSystem)
+            .add<System<Reads<Collectable, Value, GrabbedJoint, PlayerInfo, ScoredTag>,
+                        Writes<Match, ScoredTag>>>(
+                "Score", ScoreSystem)
+            .add<System<Reads<RoperTag, Position, Rotation, PlayerInfo, PhysicsBody, GrabbedJoint, Weight>,
+                        Writes<RopeControl, Length, PlayerInput, GrabbedJoint, DestroyTag, Box2DWorld, Console>>>(
+                "RopeExtension", RopeExtensionSystem)
+            .add<System<Reads<Match, PlayerInfo>, Writes<PlayerInput, Console>>>(
+                "PlayerInput", [] { PlayerInputSystem(nullptr); })
+            .add<System<Reads<PhysicsBody, Renderable, Box2DWorld>, Writes<Position>>>(
+                "PhysicsSync", PhysicsSyncSystem)
+            .add<System<Reads<RoperTag, Collectable, PhysicsBody>,
+                        Writes<RopeControl, GrabbedJoint, Box2DWorld, Console>>>(
+                "Collision", CollisionSystem)
+            .add<System<Reads<>, Writes<Match, Console>>>(
+                "CheckForGameOver", CheckForGameOverSystem)
+            .add<System<Reads<Renderable, Position>, Writes<Renderer, MainThread>>>(
+                "Render", [=] { RenderSystem(renderer); })
+            .add<System<Reads<RoperTag, PhysicsBody, PlayerInfo, Position, Box2DWorld>,
+                        Writes<Renderer, MainThread>>>(
+                "RopeRender", [=] { RopeRenderSystem(renderer); })
+            .add<System<Reads<UIComponent, PlayerInfo, Match>, Writes<Renderer, MainThread>>>(
+                "UI", [=] { UISystem(renderer); })
+            .add<System<Reads<DestroyTag>, Writes<Structure, Box2DWorld, Console>>>(
+                "Destruction", DestructionSystem);
+        return frame;
     }
 
     //----------------------------------
@@ -1638,11 +1412,36 @@ namespace goldminer {
         using namespace bagel;
         if (!World::mask(rope).test(Component<GrabbedJoint>::Bit)) return;
 
-        auto& grabbed = World::getComponent<GrabbedJoint>(rope);
-        b2DestroyJoint(grabbed.joint);
-        World::delComponent<GrabbedJoint>(rope);
+        // The joint itself goes with the GrabbedJoint (see ReleaseGrabbedJoint)
+        const auto& grabbed = World::getComponent<GrabbedJoint>(rope);
+        CommandBuffer& commands = CommandBuffer::local();
+        commands.del<GrabbedJoint>(rope);
         ent_type item{grabbed.attachedEntityId};
-        World::addComponent<DestroyTag>(item, {});
+        if (World::alive(item))
+            commands.add<DestroyTag>(item, {});
+    }
+
+    /**
+     * @brief Remove hook of PhysicsBody: destroys the body and its entity user data.
+     *
+     * Destroying the body also destroys the joints attached to it.
+     */
+    void ReleasePhysicsBody(bagel::ent_type, PhysicsBody& phys) {
+        if (!b2Body_IsValid(phys.bodyId)) return;
+        delete static_cast<bagel::ent_type*>(b2Body_GetUserData(phys.bodyId));
+        b2DestroyBody(phys.bodyId);
+        phys.bodyId = b2_nullBodyId;
+    }
+
+    /**
+     * @brief Remove hook of GrabbedJoint: destroys the weld joint.
+     *
+     * The rope and the item share the joint; whichever loses it first destroys it.
+     */
+    void ReleaseGrabbedJoint(bagel::ent_type, GrabbedJoint& grabbed) {
+        if (b2Joint_IsValid(grabbed.joint))
+            b2DestroyJoint(grabbed.joint);
+        grabbed.joint = b2_nullJointId;
     }
 
     //----------------------------------
@@ -10,7 +10,6 @@
 #define GOLD_MINER_ECS_H
 
 #include <cstdint>
-#include <string>
 #include <SDL3/SDL.h>
 #include <box2d/box2d.h>
 
@@ -18,6 +17,8 @@
 namespace bagel
 {
     struct ent_type;
+    class Scheduler;
+    using symbol_type = std::uint32_t;
 }
 
 namespace goldminer
@@ -25,8 +26,6 @@ namespace goldminer
     // Global Box2D world for physics (preview API)
     extern b2WorldId gWorld;
     using id_type = int;
-    extern id_type player_id;
-    extern bool game_over ;
 
     //----------------------------------
     /// @section Components
@@ -60,6 +59,7 @@ namespace goldminer
 
     struct RopeControl {
         enum class State { AtRest, Extending, Retracting } state = State::AtRest;
+        float swingDirection = 1.0f; ///< +1 or -1, the way the rope swings at rest
     };
 
     struct ItemType {
@@ -74,14 +74,6 @@ namespace goldminer
         float w = 1.0f;
     };
 
-    struct Score {
-        int points = 0;
-    };
-
-    struct GameTimer {
-        float timeLeft = 60.0f;
-    };
-
     struct UIComponent {
         int uiID = -1;
     };
@@ -91,7 +83,7 @@ namespace goldminer
     };
 
     struct Name {
-        std::string label;
+        bagel::symbol_type label = 0; ///< Interned with bagel::Strings::intern
     };
 
     struct Health {
@@ -109,7 +101,7 @@ namespace goldminer
 
     struct GrabbedJoint {
         b2JointId joint = b2_nullJointId;
-        int attachedEntityId = -1;
+        int attachedEntityId = -1; ///< Versioned handle id, check with World::alive
     };
 
     struct PhysicsBody {
@@ -134,10 +126,35 @@ namespace goldminer
     struct Collidable {};
     struct DestroyTag {};
 
+    //----------------------------------
+    /// @section Resources
+    //----------------------------------
+    /// Scheduler access tokens for state that lives outside the ECS.
+
+    struct Box2DWorld {};  ///< gWorld and its bodies and joints
+    struct Renderer {};    ///< The SDL renderer
+    struct Console {};     ///< std::cout / std::cerr, kept in frame order
+
+    /// State of the current match, a World resource (World::resource) that
+    /// systems also name as their scheduler token. Per-player tables are
+    /// indexed by player slot (playerID - 1).
+    struct Match {
+        static constexpr int Players = 2;
+
+        float timeLeft[Players] = {}; ///< Seconds left on each player's timer
+        int score[Players] = {};      ///< Points collected by each player
+        bool over = false;            ///< Set once every timer ran out
+        int winner = 0;               ///< Winning playerID, 0 for a tie
+
+        /// Whether playerID names a slot of the per-player tables.
+        static bool IsPlayer(int playerID) { return playerID >= 1 && playerID <= Players; }
+    };
+
 //----------------------------------
 /// @section System Declarations
 //----------------------------------
     void initBox2DWorld();
+    void ResetMatch();
     void PlayerInputSystem(const SDL_Event* event);
     void RopeSwingSystem();
     void RopeExtensionSystem();
@@ -157,8 +174,11 @@ namespace goldminer
     void RopeRenderSystem(SDL_Renderer* renderer);
     void Box2DDebugRenderSystem(SDL_Renderer* renderer);
     void HandleRopeJointCleanup(bagel::ent_type rope);
+    void ReleasePhysicsBody(bagel::ent_type e, PhysicsBody& phys);
+    void ReleaseGrabbedJoint(bagel::ent_type e, GrabbedJoint& grabbed);
     void DestructionSystem();
     void CheckForGameOverSystem();
+    bagel::Scheduler& FrameScheduler(SDL_Renderer* renderer, float timeStep);
 
 
 //----------------------------------
@@ -172,7 +192,6 @@ namespace goldminer
     id_type CreateDiamond(float x, float y);
     id_type CreateMysteryBag(float x, float y);
     id_type CreateTreasureChest(float x, float y);
-    id_type CreateTimer();
     id_type CreateUIEntity(int playerID);
     id_type CreateMole(float x, float y);
 
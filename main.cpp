@@ -5,6 +5,7 @@
 #include "gold_miner_ecs.h"
 #include "sprite_manager.h"
 #include "bagel.h"
+#include "bagel_scheduler.h"
 
 #include <iostream>
 
@@ -56,6 +57,8 @@ int main() {
 
                 if (gameState == GameState::MainMenu && key == SDLK_RETURN) {
                     // === Initialize game ===
+                    goldminer::ResetMatch();
+
                     goldminer::CreatePlayer(1);
                     goldminer::CreatePlayer(2);
 
@@ -73,17 +76,8 @@ int main() {
                     goldminer::CreateUIEntity(1);
                     goldminer::CreateUIEntity(2);
 
-                    bagel::Entity score1 = bagel::Entity::create();
-                    score1.addAll(goldminer::Score{0}, goldminer::PlayerInfo{1});
-
-                    bagel::Entity score2 = bagel::Entity::create();
-                    score2.addAll(goldminer::Score{0}, goldminer::PlayerInfo{2});
-
-                    bagel::Entity timer1 = bagel::Entity::create();
-                    timer1.addAll(goldminer::GameTimer{30.0f}, goldminer::PlayerInfo{1});
-
-                    bagel::Entity timer2 = bagel::Entity::create();
-                    timer2.addAll(goldminer::GameTimer{30.0f}, goldminer::PlayerInfo{2});
+                    for (float& timeLeft : bagel::World::resource<goldminer::Match>().timeLeft)
+                        timeLeft = 30.0f;
 
                     gameState = GameState::Playing;
                 } else if (gameState == GameState::Playing && key == SDLK_ESCAPE) {
@@ -113,29 +107,16 @@ int main() {
 
 
             // Systems
-            goldminer::GameTimerSystem(timeStep);
-            goldminer::RopeSwingSystem();
-            goldminer::ScoreSystem();
-            goldminer::RopeExtensionSystem();
-            goldminer::PlayerInputSystem(nullptr);
-            goldminer::PhysicsSyncSystem();
-            goldminer::CollisionSystem();
-            goldminer::CheckForGameOverSystem();
-
-
-            goldminer::RenderSystem(renderer);
-            goldminer::RopeRenderSystem(renderer);
-            goldminer::UISystem(renderer);
-            goldminer::DestructionSystem();
-
-            if (goldminer::game_over) {
+            goldminer::FrameScheduler(renderer, timeStep).run();
+
+            if (bagel::World::resource<goldminer::Match>().over) {
                 gameState = GameState::GameOver;
             }
 
 
         }
         else if (gameState == GameState::GameOver) {
-            int winner = goldminer::player_id;
+            int winner = bagel::World::resource<goldminer::Match>().winner;
 
             SDL_Texture* winTexture = nullptr;
 
@@ -160,6 +141,9 @@ int main() {
         SDL_Delay(16);  // ~60 FPS
     }
 
+    // How much of the frame could overlap (arguments are ignored once built)
+    goldminer::FrameScheduler(renderer, 0.0f).print(std::cout);
+
     SDL_DestroyTexture(menuTexture);
     UnloadAllSprites();
     SDL_DestroyRenderer(renderer);